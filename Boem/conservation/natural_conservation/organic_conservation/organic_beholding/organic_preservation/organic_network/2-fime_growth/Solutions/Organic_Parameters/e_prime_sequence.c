@@ -1,36 +1,255 @@
-// compile: clang e_prime_sequence.c -o e_prime_sequence -lm
-// execute ./e_prime_sequence
+// compile: clang e_prime_sequence.c -o e_prime_sequence -lm -lpthread
+// execute ./e_prime_sequence                       (i from 1 to 530)
+//         ./e_prime_sequence <first> <last> [--threads N] [--mr] [--bench]
+//
+//   --threads N  split the range across N threads (default: all cores)
+//   --mr         test each floor(i*e) with 64-bit Miller–Rabin instead of
+//                the segmented sieve (better for sparse, very large i)
+//   --bench      time the range for 1, 2, 4 … N threads, print primes/sec
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 
-// Function to check if a number is prime
-// Returns 1 if prime, 0 otherwise
-int isPrime(long long n) {
-    if (n <= 1) return 0;
-    if (n == 2) return 1;
-    if (n % 2 == 0) return 0;
-    
-    for (long long i = 3; i * i <= n; i += 2) {
-        if (n % i == 0) return 0;
-    }
-    
+#define SEGMENT_SIZE (256 * 1024)   // values per sieve segment, fits in L2
+#define BASE_LIMIT   (1ull << 28)   // base primes kept (~58 MB): values below 2^56
+
+// e = 2 + E_FRAC / 2^128 (the 128 bits after the binary point)
+#define E_FRAC_HI 0xB7E151628AED2A6Aull
+#define E_FRAC_LO 0xBF7158809CF4F3C7ull
+
+// Exact floor(i * e) in integer arithmetic, valid for i < 2^64 / e.
+// Doubles lose the integer part once i * e passes 2^53.
+static uint64_t floor_i_e(uint64_t i) {
+    unsigned __int128 hi = (unsigned __int128)i * E_FRAC_HI;
+    unsigned __int128 lo = (unsigned __int128)i * E_FRAC_LO;
+    return 2 * i + (uint64_t)((hi + (lo >> 64)) >> 64);
+}
+
+// Function to check if a number is prime (deterministic Miller–Rabin)
+// Returns 1 if prime, 0 otherwise; exact for every 64-bit n
+static uint64_t mulmod(uint64_t a, uint64_t b, uint64_t m) {
+    return (uint64_t)((unsigned __int128)a * b % m);
+}
+
+static uint64_t powmod(uint64_t a, uint64_t e, uint64_t m) {
+    uint64_t r = 1;
+    for (a %= m; e; e >>= 1) {
+        if (e & 1) r = mulmod(r, a, m);
+        a = mulmod(a, a, m);
+    }
+    return r;
+}
+
+int isPrime(uint64_t n) {
+    static const uint64_t bases[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+    if (n < 2) return 0;
+    for (int k = 0; k < 12; k++) {
+        if (n == bases[k]) return 1;
+        if (n % bases[k] == 0) return 0;
+    }
+    uint64_t d = n - 1;
+    int s = 0;
+    while (!(d & 1)) { d >>= 1; s++; }
+    for (int k = 0; k < 12; k++) {
+        uint64_t x = powmod(bases[k], d, n);
+        if (x == 1 || x == n - 1) continue;
+        int composite = 1;
+        for (int r = 1; r < s && composite; r++) {
+            x = mulmod(x, x, n);
+            if (x == n - 1) composite = 0;
+        }
+        if (composite) return 0;
+    }
     return 1;
 }
 
-int main() {
-    double e = M_E;
-	
-    printf("Calculating the sequence i * e for i from 1 to 530:\n\n");
-
-	    for (int i = 1; i <= 530; ++i) {
-	        double result = i * e;
-	        long long result_floored = (long long)floor(result);
-	        
-	        if (isPrime(result_floored)) {
-            printf("%d * e = %f -> Rounded down to %lld.\n", 
-                   i, result, result_floored);
-        	}
-	    }
+// Base primes up to sqrt of the largest value, shared by every thread
+static uint32_t *base_primes;
+static size_t base_count;
+
+// Sieved a window at a time, so only the primes themselves take memory.
+// Returns 0 when the range needs base primes past BASE_LIMIT.
+static int sieve_base_primes(uint64_t max_value) {
+    uint64_t limit = (uint64_t)sqrtl((long double)max_value) + 2;
+    if (limit > BASE_LIMIT) return 0;
+    // pi(x) < 1.26 x / ln x
+    size_t cap = (size_t)(1.26 * (double)limit / log((double)limit)) + 16;
+    unsigned char *seg = malloc(SEGMENT_SIZE);
+    base_primes = malloc(cap * sizeof(uint32_t));
+    if (!seg || !base_primes) { perror("sieve_base_primes"); exit(1); }
+    base_count = 0;
+    for (uint64_t lo = 0; lo <= limit; lo += SEGMENT_SIZE) {
+        uint64_t hi = lo + SEGMENT_SIZE <= limit + 1 ? lo + SEGMENT_SIZE : limit + 1;
+        memset(seg, 1, hi - lo);
+        for (uint64_t v = lo; v < 2 && v < hi; v++) seg[v - lo] = 0;
+        // the primes that cross out this window were all found in earlier ones
+        for (size_t k = 0; k < base_count; k++) {
+            uint64_t p = base_primes[k];
+            if (p * p >= hi) break;
+            uint64_t m = (lo + p - 1) / p * p;
+            if (m < p * p) m = p * p;
+            for (; m < hi; m += p) seg[m - lo] = 0;
+        }
+        for (uint64_t v = lo; v < hi; v++) {
+            if (!seg[v - lo]) continue;
+            base_primes[base_count++] = (uint32_t)v;
+            for (uint64_t m = v * v; m < hi; m += v) seg[m - lo] = 0;
+        }
+    }
+    free(seg);
+    return 1;
+}
+
+// One thread's share of the i range
+typedef struct {
+    uint64_t first, last;   // inclusive i range
+    int use_mr;
+    int keep_hits;
+    uint64_t *hits;         // i values whose floor(i*e) is prime
+    size_t nhits, cap;
+    int threaded;           // ran on its own thread (so is joined)
+} Work;
+
+static void add_hit(Work *w, uint64_t i) {
+    w->nhits++;
+    if (!w->keep_hits) return;
+    if (w->nhits > w->cap) {
+        w->cap = w->cap ? w->cap * 2 : 1024;
+        w->hits = realloc(w->hits, w->cap * sizeof(uint64_t));
+        if (!w->hits) { perror("add_hit"); exit(1); }
+    }
+    w->hits[w->nhits - 1] = i;
+}
+
+// Segmented sieve over the values floor(first*e) .. floor(last*e)
+static void *sieve_range(void *arg) {
+    Work *w = arg;
+    if (w->first > w->last) return NULL;
+    if (w->use_mr) {
+        for (uint64_t i = w->first; i <= w->last; i++)
+            if (isPrime(floor_i_e(i))) add_hit(w, i);
+        return NULL;
+    }
+    unsigned char *seg = malloc(SEGMENT_SIZE);
+    if (!seg) { perror("sieve_range"); exit(1); }
+    uint64_t i = w->first;
+    uint64_t v_end = floor_i_e(w->last) + 1;
+    for (uint64_t lo = floor_i_e(w->first); lo < v_end; lo += SEGMENT_SIZE) {
+        uint64_t hi = lo + SEGMENT_SIZE < v_end ? lo + SEGMENT_SIZE : v_end;
+        memset(seg, 1, hi - lo);
+        for (uint64_t v = lo; v < 2 && v < hi; v++) seg[v - lo] = 0;
+        for (size_t k = 0; k < base_count; k++) {
+            uint64_t p = base_primes[k];
+            if (p * p >= hi) break;
+            uint64_t m = (lo + p - 1) / p * p;
+            if (m < p * p) m = p * p;
+            for (; m < hi; m += p) seg[m - lo] = 0;
+        }
+        for (uint64_t v; i <= w->last && (v = floor_i_e(i)) < hi; i++)
+            if (seg[v - lo]) add_hit(w, i);
+    }
+    free(seg);
+    return NULL;
+}
+
+// Run [first, last] across nthreads; returns the Work array (caller frees).
+// A share whose thread cannot be started runs on the calling thread.
+static Work *run_range(uint64_t first, uint64_t last, int nthreads, int use_mr, int keep_hits) {
+    uint64_t span = last - first + 1;
+    if ((uint64_t)nthreads > span) nthreads = (int)span;
+    Work *work = calloc((size_t)nthreads, sizeof(Work));
+    pthread_t *tid = malloc((size_t)nthreads * sizeof(pthread_t));
+    if (!work || !tid) { perror("run_range"); exit(1); }
+    for (int t = 0; t < nthreads; t++) {
+        work[t].first = first + span * (uint64_t)t / (uint64_t)nthreads;
+        work[t].last = first + span * (uint64_t)(t + 1) / (uint64_t)nthreads - 1;
+        work[t].use_mr = use_mr;
+        work[t].keep_hits = keep_hits;
+        work[t].threaded = pthread_create(&tid[t], NULL, sieve_range, &work[t]) == 0;
+        if (!work[t].threaded) sieve_range(&work[t]);
+    }
+    for (int t = 0; t < nthreads; t++)
+        if (work[t].threaded) pthread_join(tid[t], NULL);
+    free(tid);
+    return work;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void benchmark(uint64_t first, uint64_t last, int max_threads, int use_mr) {
+    printf("Benchmark: i from %llu to %llu, %s\n\n", (unsigned long long)first,
+           (unsigned long long)last, use_mr ? "Miller-Rabin" : "segmented sieve");
+    printf("threads      primes      seconds      primes/sec   primes/sec/thread\n");
+    for (int t = 1;; t *= 2) {
+        if (t > max_threads) t = max_threads;
+        double t0 = now_s();
+        Work *work = run_range(first, last, t, use_mr, 0);
+        double dt = now_s() - t0;
+        uint64_t found = 0;
+        for (int k = 0; k < t && (uint64_t)k <= last - first; k++) found += work[k].nhits;
+        free(work);
+        printf("%7d %11llu %12.4f %15.0f %19.0f\n", t, (unsigned long long)found, dt,
+               found / dt, found / dt / t);
+        if (t == max_threads) break;
+    }
+}
+
+int main(int argc, char **argv) {
+    uint64_t first = 1, last = 530;
+    int nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int use_mr = 0, bench = 0, positional = 0;
+    if (nthreads < 1) nthreads = 1;
+
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) nthreads = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--mr") == 0) use_mr = 1;
+        else if (strcmp(argv[a], "--bench") == 0) bench = 1;
+        else if (positional == 0) { first = strtoull(argv[a], NULL, 10); positional++; }
+        else if (positional == 1) { last = strtoull(argv[a], NULL, 10); positional++; }
+        else {
+            fprintf(stderr, "Usage: %s [first last] [--threads N] [--mr] [--bench]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (nthreads < 1) nthreads = 1;
+    if (first < 1) first = 1;
+    if (last < first || last > UINT64_MAX / 3) {
+        fprintf(stderr, "Invalid range: need 1 <= first <= last < %llu\n",
+                (unsigned long long)(UINT64_MAX / 3));
+        return 1;
+    }
+    if (!use_mr && !sieve_base_primes(floor_i_e(last))) {
+        fprintf(stderr, "Values past 2^56 need too many sieve primes; using Miller-Rabin (--mr)\n");
+        use_mr = 1;
+    }
+
+    if (bench) {
+        benchmark(first, last, nthreads, use_mr);
+        return 0;
+    }
+
+    printf("Calculating the sequence i * e for i from %llu to %llu:\n\n",
+           (unsigned long long)first, (unsigned long long)last);
+
+    Work *work = run_range(first, last, nthreads, use_mr, 1);
+    for (int t = 0; t < nthreads && (uint64_t)t <= last - first; t++) {
+        for (size_t k = 0; k < work[t].nhits; k++) {
+            uint64_t i = work[t].hits[k];
+            printf("%llu * e = %f -> Rounded down to %llu.\n",
+                   (unsigned long long)i, (double)i * M_E, (unsigned long long)floor_i_e(i));
+        }
+        free(work[t].hits);
+    }
+    free(work);
     return 0;
 }
@@ -1,6 +1,21 @@
 // safe_gov_outbox.c (pseudocode for Forenzo)
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
+#include "../../../5-atmosphere/Solutions/Forenzo/forenzo_audit.h"
+#include "../../../5-atmosphere/Solutions/Forenzo/forenzo_json.h"
+
+// forenzo_activity.log, shared with the Forenzo programs; opened on
+// first use and drained at exit
+static AuditLog activity;
+
+static void close_activity_log(void) { audit_close(&activity); }
+
+static AuditLog *activity_log(void) {
+    if (!activity.ring && audit_open(&activity, "forenzo_activity.log", AUDIT_POLICY_DEFAULT))
+        atexit(close_activity_log);
+    return &activity;
+}
 
 // create a validated JSON package for agency -> written to gov_outbox/
 int create_gov_package(const char *agency, const char *purpose, const char *summary, const char *details, const char *attachment_path) {
@@ -16,28 +31,49 @@ int create_gov_package(const char *agency, const char *purpose, const char *summ
     char fname[768];
     snprintf(fname, sizeof(fname), "%s/%s_%s.json", dir, ts, "forenzo_request");
 
-    FILE *f = fopen(fname, "w");
-    if (!f) { perror("open outbox file"); return 0; }
-
-    fprintf(f, "{\n");
-    fprintf(f, "  \"when\": \"%s\",\n", ts);
-    fprintf(f, "  \"to_agency\": \"%s\",\n", agency);
-    fprintf(f, "  \"purpose\": \"%s\",\n", purpose);
-    fprintf(f, "  \"sender\": { \"name\": \"Forest\", \"contact\": \"\" },\n");
-    fprintf(f, "  \"payload\": { \"summary\": \"%s\", \"details\": \"%s\", \"attachments\": [\"%s\"] },\n",
-            summary, details, attachment_path ? attachment_path : "");
-    fprintf(f, "  \"provenance\": { \"prepared_by\": \"Forenzo\", \"prepared_at\": \"%s\" },\n", ts);
-    fprintf(f, "  \"consent_required\": true,\n");
-    fprintf(f, "  \"status\": \"pending\"\n");
-    fprintf(f, "}\n");
-    fclose(f);
-
-    // log locally
-    FILE *log = fopen("forenzo_activity.log","a");
-    if (log) {
-        fprintf(log, "{\"ts\":\"%s\",\"event\":\"gov_package_created\",\"agency\":\"%s\",\"file\":\"%s\"}\n", ts, agency, fname);
-        fclose(log);
-    }
+    // built in one reused buffer, escaped, written with a single write()
+    static char doc[128 * 1024];
+    JsonWriter j;
+    json_init(&j, doc, sizeof(doc));
+    json_begin_object(&j);
+    json_kv_str(&j, "when", ts);
+    json_kv_str(&j, "to_agency", agency);
+    json_kv_str(&j, "purpose", purpose);
+    json_key(&j, "sender");
+    json_begin_inline(&j);
+    json_kv_str(&j, "name", "Forest");
+    json_kv_str(&j, "contact", "");
+    json_end_object(&j);
+    json_key(&j, "payload");
+    json_begin_inline(&j);
+    json_kv_str(&j, "summary", summary);
+    json_kv_str(&j, "details", details);
+    json_key(&j, "attachments");
+    json_begin_array_inline(&j);
+    json_string(&j, attachment_path ? attachment_path : "");
+    json_end_array(&j);
+    json_end_object(&j);
+    json_key(&j, "provenance");
+    json_begin_inline(&j);
+    json_kv_str(&j, "prepared_by", "Forenzo");
+    json_kv_str(&j, "prepared_at", ts);
+    json_end_object(&j);
+    json_kv_bool(&j, "consent_required", 1);
+    json_kv_str(&j, "status", "pending");
+    json_end_object(&j);
+    if (!json_write_file(fname, &j, 0)) { perror("write outbox file"); return 0; }
+
+    // log locally (queued; the audit writer thread does the I/O)
+    char line[2048];
+    json_init(&j, line, sizeof(line));
+    json_begin_compact(&j);
+    json_kv_str(&j, "ts", ts);
+    json_kv_str(&j, "event", "gov_package_created");
+    json_kv_str(&j, "agency", agency);
+    json_kv_str(&j, "file", fname);
+    json_end_object(&j);
+    size_t n = json_finish(&j);
+    if (n) audit_log(activity_log(), line, n);
     printf("I created outbox package: %s\n", fname);
     return 1;
 }
@@ -10,14 +10,26 @@ VERSION="v0.5"
 # Ensure SanDisk path exists
 mkdir -p "$SAN_DISK"
 
-# Backup with version + date
-BACKUP_FILE="$SAN_DISK/forenzo_${VERSION}_${DATE}.c"
-cp "$SOURCE" "$BACKUP_FILE"
-echo "📦 Backed up $SOURCE → $BACKUP_FILE"
-
 # Compile
-clang -o forenzo "$SOURCE"
-if [ $? -eq 0 ]; then
+clang -o forenzo "$SOURCE" -lpthread -lm
+BUILD=$?
+
+# Backup with version + date: a manifest in $SAN_DISK plus only the chunks
+# the store lacks (see forenzo_sync.h); restore one with
+#   ./forenzo --sync-pull "$SAN_DISK" forenzo_<version>_<date>.c <file>
+# A failed build leaves the previous ./forenzo to make the backup; with no
+# ./forenzo at all, or a failed push, a plain copy goes there instead.
+BACKUP_NAME="forenzo_${VERSION}_${DATE}.c"
+if [ -x ./forenzo ] && ./forenzo --sync-push "$SAN_DISK" "$SOURCE" "$BACKUP_NAME"; then
+  echo "📦 Backed up $SOURCE → $SAN_DISK/$BACKUP_NAME.fzm"
+elif cp "$SOURCE" "$SAN_DISK/$BACKUP_NAME"; then
+  echo "📦 Backed up $SOURCE → $SAN_DISK/$BACKUP_NAME (plain copy)"
+else
+  echo "❌ Backup failed."
+  exit 1
+fi
+
+if [ $BUILD -eq 0 ]; then
   echo "✅ Compilation successful: ./forenzo ready"
 else
   echo "❌ Compilation failed."
@@ -37,23 +49,9 @@ else
   CYCLE=$(($(tail -n 1 "$LOG_FILE" | awk '{print $1}') + 1))
 fi
 
-# Function: nearest prime
+# Function: nearest prime (shared sieve oracle in the freshly built forenzo)
 nearest_prime() {
-  n=$1
-  while :; do
-    is_prime=1
-    for ((i=2; i*i<=n; i++)); do
-      if (( n % i == 0 )); then
-        is_prime=0
-        break
-      fi
-    done
-    if (( is_prime == 1 )); then
-      echo $n
-      return
-    fi
-    ((n++))
-  done
+  ./forenzo --nearest-prime "$1"
 }
 
 # Calculate harmonic step
@@ -0,0 +1,40 @@
+// bench_forenzo.c — forenzo.c: append_entry, last-entry summary, primes,
+// and the cost of one stats event (clock read + histogram update)
+#define FORENZO_NO_MAIN
+#pragma GCC diagnostic ignored "-Wunused-function"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#include "../forenzo.c"
+#include "forenzo_bench.h"
+
+void bench_forenzo(void) {
+    remove_state(BENCH_LOG);
+    if (!open_state(BENCH_LOG, LOG_POLICY_DEFAULT)) return;
+
+    double t0 = bench_now();
+    for (long i = 0; i < BENCH_APPENDS; i++)
+        append_entry("bench", "synthetic observation", "synthetic solution");
+    bench_record("append_entry", BENCH_APPENDS, bench_now() - t0);
+
+    // reflect|prompt: "Last preserved: ..." via the offset index
+    t0 = bench_now();
+    for (long i = 0; i < BENCH_REFLECTS; i++) reflect(stdout, "prompt");
+    bench_record("last_entry_summary", BENCH_REFLECTS, bench_now() - t0);
+
+    close_state();
+    remove_state(BENCH_LOG);
+
+    t0 = bench_now();
+    long sum = 0;
+    for (long i = 0; i < BENCH_PRIMES; i++) sum += nearest_prime((int)((i * 7919) % 1000000));
+    bench_record("nearest_prime", BENCH_PRIMES, bench_now() - t0);
+
+    t0 = bench_now();
+    for (long i = 0; i < BENCH_PRIMES; i++) sum += euler_prime_step((int)(i % 100000) + 1);
+    bench_record("euler_prime_step", BENCH_PRIMES, bench_now() - t0);
+    if (sum == 42) printf("\n");    // keep the loops
+
+    static Metric m = { .name = "bench" };
+    t0 = bench_now();
+    for (long i = 0; i < BENCH_METRICS; i++) metric_since(&m, metric_now());
+    bench_record("metric_record", BENCH_METRICS, bench_now() - t0);
+}
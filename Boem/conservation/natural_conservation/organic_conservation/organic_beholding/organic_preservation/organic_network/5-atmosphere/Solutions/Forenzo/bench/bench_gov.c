@@ -0,0 +1,16 @@
+// bench_gov.c — forenzo_gov.c: create_gov_package
+#define FORENZO_NO_MAIN
+#pragma GCC diagnostic ignored "-Wunused-function"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#include "../forenzo_gov.c"
+#include "forenzo_bench.h"
+
+void bench_gov(void) {
+    char agency[32];
+    double t0 = bench_now();
+    for (long i = 0; i < BENCH_PACKAGES; i++) {
+        snprintf(agency, sizeof(agency), "agency%02ld", i % 50);
+        create_gov_package(agency, "synthetic purpose", "synthetic summary", "synthetic details");
+    }
+    bench_record("create_gov_package", BENCH_PACKAGES, bench_now() - t0);
+}
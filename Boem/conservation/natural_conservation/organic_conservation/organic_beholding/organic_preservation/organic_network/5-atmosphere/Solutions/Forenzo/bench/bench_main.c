@@ -0,0 +1,150 @@
+// bench_main.c — forenzo_bench: times the Forenzo hot paths
+//   forenzo_bench [--out results.json] [--baseline old.json] [--tolerance pct]
+// Runs in a scratch directory so no real state is touched, prints the
+// results as JSON (to stdout or --out), and with --baseline exits 1 when
+// any benchmark's ops/sec falls more than `tolerance` percent below it.
+// The suite runs BENCH_ROUNDS times and keeps each benchmark's best time,
+// which damps scheduler and page-cache noise.
+
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include "forenzo_bench.h"
+
+#define BENCH_MAX    32
+#define BENCH_ROUNDS 3
+
+typedef struct {
+    char name[48];
+    long n;
+    double seconds;
+} BenchResult;
+
+static BenchResult results[BENCH_MAX];
+static int nresults;
+static int saved_stdout = -1;
+
+void bench_record(const char *name, long n, double seconds) {
+    fflush(stdout);
+    if (saved_stdout >= 0) dprintf(saved_stdout, "%-20s %10ld ops  %10.3f ms\n", name, n, seconds * 1e3);
+    for (int i = 0; i < nresults; i++)
+        if (strcmp(results[i].name, name) == 0) {
+            if (seconds < results[i].seconds) results[i].seconds = seconds;
+            return;
+        }
+    if (nresults == BENCH_MAX) return;
+    BenchResult *r = &results[nresults++];
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->n = n;
+    r->seconds = seconds;
+}
+
+static double ops_per_sec(const BenchResult *r) {
+    return r->seconds > 0 ? r->n / r->seconds : 0;
+}
+
+// The hot paths print as they go; silence them while timing.
+static void quiet(int on) {
+    fflush(stdout);
+    if (on) {
+        int null = open("/dev/null", O_WRONLY);
+        saved_stdout = dup(STDOUT_FILENO);
+        dup2(null, STDOUT_FILENO);
+        close(null);
+    } else if (saved_stdout >= 0) {
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+        saved_stdout = -1;
+    }
+}
+
+static void write_json(FILE *f) {
+    fprintf(f, "{\"suite\":\"forenzo\",\"results\":[");
+    for (int i = 0; i < nresults; i++) {
+        const BenchResult *r = &results[i];
+        double ops = ops_per_sec(r);
+        fprintf(f, "%s\n  {\"name\":\"%s\",\"n\":%ld,\"seconds\":%.6f,\"ops_per_sec\":%.1f,\"ns_per_op\":%.1f}",
+                i ? "," : "", r->name, r->n, r->seconds, ops, ops > 0 ? 1e9 / ops : 0);
+    }
+    fprintf(f, "\n]}\n");
+}
+
+// ops_per_sec of `name` in a file written by write_json, or 0.
+static double baseline_ops(const char *json, const char *name) {
+    char key[80];
+    snprintf(key, sizeof(key), "\"name\":\"%.47s\"", name);
+    const char *p = strstr(json, key);
+    if (!p) return 0;
+    p = strstr(p, "\"ops_per_sec\":");
+    return p ? atof(p + 14) : 0;
+}
+
+static int compare(const char *path, double tolerance) {
+    FILE *f = fopen(path, "r");
+    if (!f) { perror(path); return 1; }
+    static char json[64 * 1024];
+    size_t n = fread(json, 1, sizeof(json) - 1, f);
+    json[n] = 0;
+    fclose(f);
+    int regressed = 0;
+    for (int i = 0; i < nresults; i++) {
+        double before = baseline_ops(json, results[i].name), now = ops_per_sec(&results[i]);
+        if (before <= 0) continue;
+        double change = (now - before) / before * 100;
+        int bad = change < -tolerance;
+        fprintf(stderr, "%-20s %+7.1f%%%s\n", results[i].name, change, bad ? "  REGRESSION" : "");
+        regressed |= bad;
+    }
+    return regressed;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void)st; (void)flag; (void)ftw;
+    return remove(path);
+}
+
+int main(int argc, char **argv) {
+    const char *out = NULL, *baseline = NULL;
+    double tolerance = 25;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) out = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) baseline = argv[++i];
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) tolerance = atof(argv[++i]);
+        else {
+            fprintf(stderr, "Usage: %s [--out results.json] [--baseline old.json] [--tolerance pct]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    char cwd[4096], scratch[] = "/tmp/forenzo_bench.XXXXXX";
+    if (!getcwd(cwd, sizeof(cwd)) || !mkdtemp(scratch) || chdir(scratch) != 0) {
+        perror("scratch directory");
+        return 1;
+    }
+
+    quiet(1);
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        // every round starts from an empty directory
+        char dir[64];
+        snprintf(dir, sizeof(dir), "%s/%d", scratch, round);
+        if (mkdir(dir, 0700) != 0 || chdir(dir) != 0) break;
+        bench_forenzo();
+        bench_syslang();
+        bench_gov();
+    }
+    quiet(0);
+
+    if (chdir(cwd) != 0) perror(cwd);
+    nftw(scratch, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+    FILE *f = out ? fopen(out, "w") : stdout;
+    if (!f) { perror(out); return 1; }
+    write_json(f);
+    if (out) fclose(f);
+    return baseline ? compare(baseline, tolerance) : 0;
+}
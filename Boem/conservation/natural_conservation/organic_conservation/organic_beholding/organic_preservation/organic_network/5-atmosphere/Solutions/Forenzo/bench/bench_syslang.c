@@ -0,0 +1,42 @@
+// bench_syslang.c — forenzo_syslang.c: load_memory, code_from_string
+#define FORENZO_NO_MAIN
+#pragma GCC diagnostic ignored "-Wunused-function"
+#include "../forenzo_syslang.c"
+#include "forenzo_bench.h"
+
+void bench_syslang(void) {
+    char obs[32], sol[32], col[16];
+    if (!load_memory()) return;
+    for (long i = 0; i < BENCH_TOKENS; i++) {
+        snprintf(col, sizeof(col), "c%ld", i % 32);
+        snprintf(obs, sizeof(obs), "observation %ld", i);
+        snprintf(sol, sizeof(sol), "solution %ld", i % 1000);
+        append_memory_binary(col, obs, sol);
+    }
+    close_memory();
+
+    double t0 = bench_now();
+    for (int i = 0; i < BENCH_LOADS; i++) {
+        if (!load_memory()) return;
+        close_memory();
+    }
+    bench_record("load_memory", BENCH_LOADS, bench_now() - t0);
+
+    char **strings = malloc(BENCH_DISTINCT * sizeof(char *));
+    if (!strings) return;
+    for (long i = 0; i < BENCH_DISTINCT; i++) {
+        char s[32];
+        snprintf(s, sizeof(s), "term %ld", i * 2654435761u % 1000003);
+        strings[i] = strdup(s);
+    }
+    uint64_t sum = 0;
+    if (load_memory()) {
+        t0 = bench_now();
+        for (long i = 0; i < BENCH_STRINGS; i++) sum += code_from_string(&dictionary, strings[i % BENCH_DISTINCT]);
+        bench_record("code_from_string", BENCH_STRINGS, bench_now() - t0);
+        close_memory();
+    }
+    for (long i = 0; i < BENCH_DISTINCT; i++) free(strings[i]);
+    free(strings);
+    if (sum == 42) printf("\n");
+}
@@ -0,0 +1,36 @@
+// forenzo_bench.h — shared pieces of the forenzo_bench executable
+// Each program's hot paths are static, so every bench_<program>.c
+// includes that program's source (with FORENZO_NO_MAIN) and reports
+// its timings through bench_record(). Datasets are fixed-size and
+// synthetic so runs compare across commits.
+
+#ifndef FORENZO_BENCH_H
+#define FORENZO_BENCH_H
+
+#include <time.h>
+
+// Dataset sizes
+#define BENCH_APPENDS   100000      // append_entry calls
+#define BENCH_REFLECTS  200000      // last-entry summaries
+#define BENCH_PRIMES    20000000    // nearest_prime / euler_prime_step calls
+#define BENCH_TOKENS    100000      // memory tokens behind load_memory
+#define BENCH_LOADS     20          // load_memory + close_memory rounds
+#define BENCH_STRINGS   1000000     // code_from_string calls
+#define BENCH_DISTINCT  200000      // distinct strings among them
+#define BENCH_PACKAGES  1000        // create_gov_package calls
+#define BENCH_METRICS   10000000    // timed stats events
+
+static inline double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// n operations took `seconds`
+void bench_record(const char *name, long n, double seconds);
+
+void bench_forenzo(void);   // append_entry, last_entry_summary, primes, metric_record
+void bench_syslang(void);   // load_memory, code_from_string
+void bench_gov(void);       // create_gov_package
+
+#endif // FORENZO_BENCH_H
@@ -0,0 +1,696 @@
+// forenzo_archive.h — compressed columnar archives for cold storage
+// One archive holds either the entries of forenzo_state.json or the
+// MemoryTokens of forenzo.bin (with their dictionary text), so it can be
+// restored on any machine. Export and import stream one block at a
+// time; memory is bounded by the block size plus the collection names.
+//
+// Layout, integers little-endian:
+//   header  "FZAR", u32 version, u32 kind, u32 CRC-32 of those 12 bytes
+//   block*  u32 rows, u32 ncols,
+//           ncols x (u8 codec, u32 raw length, u32 stored length),
+//           the column payloads, u32 CRC-32 of the block up to here
+//   end     a block with rows = 0 whose one column is the varint row
+//           total, so a truncated archive never imports silently
+//
+// Columns are varint streams (forenzo_varint.h): ids, times and ticks as
+// zigzag deltas, collections as ids into a name list that grows with
+// the archive (each block carries the names it introduces), text as
+// length-prefixed bytes. A column is stored LZ-compressed (forenzo_lz.h)
+// when that is smaller.
+
+#ifndef FORENZO_ARCHIVE_H
+#define FORENZO_ARCHIVE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "forenzo_endian.h"
+#include "forenzo_crc32.h"
+#include "forenzo_varint.h"
+#include "forenzo_lz.h"
+#include "forenzo_intern.h"
+#include "forenzo_store.h"
+
+#define ARCHIVE_MAGIC       "FZAR"
+#define ARCHIVE_VERSION     1
+#define ARCHIVE_ENTRIES     1               // forenzo_state.json lines
+#define ARCHIVE_TOKENS      2               // forenzo.bin tokens
+#define ARCHIVE_HEADER_SIZE 16
+#define ARCHIVE_MAX_COLS    8
+#define ARCHIVE_BLOCK_ROWS  16384
+#define ARCHIVE_BLOCK_BYTES (1u << 20)      // buffered column bytes that close a block
+#define ARCHIVE_COL_MAX     (64u << 20)     // largest column either side accepts
+#define ARCHIVE_RAW         0
+#define ARCHIVE_LZ          1
+
+typedef struct {
+    unsigned char *p;
+    size_t n, cap;
+} ArchiveBuf;
+
+static inline int archive_reserve(ArchiveBuf *b, size_t more) {
+    if (b->n + more <= b->cap) return 1;
+    size_t cap = b->cap ? b->cap : 4096;
+    while (cap < b->n + more) cap *= 2;
+    unsigned char *p = realloc(b->p, cap);
+    if (!p) return 0;
+    b->p = p;
+    b->cap = cap;
+    return 1;
+}
+
+static inline int archive_write_all(int fd, const unsigned char *p, size_t n) {
+    while (n) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 1;
+}
+
+static inline int archive_read_all(int fd, unsigned char *p, size_t n) {
+    while (n) {
+        ssize_t r = read(fd, p, n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return 0;
+        p += r;
+        n -= (size_t)r;
+    }
+    return 1;
+}
+
+// ---------------------------------------------------
+// Writer
+// ---------------------------------------------------
+typedef struct {
+    int fd;
+    char path[1024], tmp[1100];     // written as tmp, renamed on commit
+    unsigned ncols;
+    ArchiveBuf col[ARCHIVE_MAX_COLS];
+    ArchiveBuf block;
+    LzMatcher *lz;                  // compressor scratch, too big for the stack
+    uint32_t rows;
+    uint64_t total;
+    int failed;
+} ArchiveWriter;
+
+static inline int archive_create(ArchiveWriter *w, const char *path, uint32_t kind, unsigned ncols) {
+    memset(w, 0, sizeof(*w));
+    snprintf(w->path, sizeof(w->path), "%s", path);
+    snprintf(w->tmp, sizeof(w->tmp), "%s.tmp", path);
+    w->ncols = ncols;
+    w->lz = malloc(sizeof(LzMatcher));
+    if (!w->lz) { perror("malloc"); return 0; }
+    w->fd = open(w->tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (w->fd < 0) { perror(w->tmp); free(w->lz); return 0; }
+    unsigned char h[ARCHIVE_HEADER_SIZE];
+    memcpy(h, ARCHIVE_MAGIC, 4);
+    put_le32(h + 4, ARCHIVE_VERSION);
+    put_le32(h + 8, kind);
+    put_le32(h + 12, crc32_update(0, h, 12));
+    if (!archive_write_all(w->fd, h, sizeof(h))) { perror(w->tmp); w->failed = 1; }
+    return 1;
+}
+
+static inline void archive_varint(ArchiveWriter *w, unsigned c, uint64_t v) {
+    if (!archive_reserve(&w->col[c], VARINT_MAX)) { w->failed = 1; return; }
+    w->col[c].n += varint_put(w->col[c].p + w->col[c].n, v);
+}
+
+static inline void archive_text(ArchiveWriter *w, unsigned c, const char *s, size_t n) {
+    archive_varint(w, c, n);
+    if (!archive_reserve(&w->col[c], n)) { w->failed = 1; return; }
+    memcpy(w->col[c].p + w->col[c].n, s, n);
+    w->col[c].n += n;
+}
+
+// Compresses and writes the buffered rows as one block.
+static inline int archive_flush(ArchiveWriter *w) {
+    if (w->failed) return 0;
+    size_t need = 8 + (size_t)w->ncols * 9 + 4;
+    for (unsigned c = 0; c < w->ncols; c++) {
+        if (w->col[c].n > ARCHIVE_COL_MAX) {
+            fprintf(stderr, "%s: a record is too large to archive\n", w->path);
+            return !(w->failed = 1);
+        }
+        need += lz_bound(w->col[c].n);
+    }
+    w->block.n = 0;
+    if (!archive_reserve(&w->block, need)) return !(w->failed = 1);
+    unsigned char *b = w->block.p, *desc = b + 8, *o = desc + (size_t)w->ncols * 9;
+    put_le32(b, w->rows);
+    put_le32(b + 4, w->ncols);
+    for (unsigned c = 0; c < w->ncols; c++, desc += 9) {
+        ArchiveBuf *col = &w->col[c];
+        size_t stored = lz_compress(w->lz, col->p, col->n, o);
+        desc[0] = ARCHIVE_LZ;
+        if (stored >= col->n) {
+            if (col->n) memcpy(o, col->p, col->n);
+            stored = col->n;
+            desc[0] = ARCHIVE_RAW;
+        }
+        put_le32(desc + 1, (uint32_t)col->n);
+        put_le32(desc + 5, (uint32_t)stored);
+        o += stored;
+        col->n = 0;
+    }
+    put_le32(o, crc32_update(0, b, (size_t)(o - b)));
+    o += 4;
+    if (!archive_write_all(w->fd, b, (size_t)(o - b))) { perror(w->tmp); return !(w->failed = 1); }
+    w->total += w->rows;
+    w->rows = 0;
+    return 1;
+}
+
+// Ends a row; cuts a block once enough has built up.
+static inline void archive_row(ArchiveWriter *w) {
+    size_t bytes = 0;
+    for (unsigned c = 0; c < w->ncols; c++) bytes += w->col[c].n;
+    if (++w->rows == ARCHIVE_BLOCK_ROWS || bytes >= ARCHIVE_BLOCK_BYTES) archive_flush(w);
+}
+
+static inline void archive_free(ArchiveWriter *w) {
+    for (unsigned c = 0; c < ARCHIVE_MAX_COLS; c++) free(w->col[c].p);
+    free(w->block.p);
+    free(w->lz);
+    w->lz = NULL;
+    if (w->fd >= 0) close(w->fd);
+    w->fd = -1;
+}
+
+// Writes the end block and moves the archive into place. On failure
+// the partial file is removed and any older archive is left alone.
+static inline int archive_commit(ArchiveWriter *w) {
+    if (w->rows) archive_flush(w);
+    w->ncols = 1;
+    archive_varint(w, 0, w->total);
+    archive_flush(w);
+    int ok = !w->failed && fsync(w->fd) == 0;
+    ok = close(w->fd) == 0 && ok;
+    w->fd = -1;
+    if (ok && rename(w->tmp, w->path) != 0) { perror(w->path); ok = 0; }
+    if (!ok) unlink(w->tmp);
+    archive_free(w);
+    return ok;
+}
+
+static inline void archive_abort(ArchiveWriter *w) {
+    archive_free(w);
+    unlink(w->tmp);
+}
+
+// ---------------------------------------------------
+// Reader
+// ---------------------------------------------------
+typedef struct {
+    int fd;
+    char path[1024];
+    unsigned ncols;
+    ArchiveBuf raw, col[ARCHIVE_MAX_COLS];
+    const unsigned char *at[ARCHIVE_MAX_COLS], *end[ARCHIVE_MAX_COLS];
+    uint32_t rows;              // in the current block
+    uint64_t total;             // rows in every block so far
+    int bad;                    // a column ran short of what the rows need
+} ArchiveReader;
+
+static inline int archive_open(ArchiveReader *r, const char *path, uint32_t kind) {
+    memset(r, 0, sizeof(*r));
+    snprintf(r->path, sizeof(r->path), "%s", path);
+    r->fd = open(path, O_RDONLY);
+    if (r->fd < 0) { perror(path); return 0; }
+    unsigned char h[ARCHIVE_HEADER_SIZE];
+    if (!archive_read_all(r->fd, h, sizeof(h)) || memcmp(h, ARCHIVE_MAGIC, 4) != 0 ||
+        get_le32(h + 12) != crc32_update(0, h, 12)) {
+        fprintf(stderr, "%s: not a Forenzo archive\n", path);
+    } else if (get_le32(h + 4) != ARCHIVE_VERSION || get_le32(h + 8) != kind) {
+        fprintf(stderr, "%s: unsupported version or wrong kind of archive\n", path);
+    } else {
+        return 1;
+    }
+    close(r->fd);
+    r->fd = -1;
+    return 0;
+}
+
+static inline void archive_close(ArchiveReader *r) {
+    for (unsigned c = 0; c < ARCHIVE_MAX_COLS; c++) free(r->col[c].p);
+    free(r->raw.p);
+    if (r->fd >= 0) close(r->fd);
+    r->fd = -1;
+}
+
+static inline int archive_corrupt(ArchiveReader *r, const char *what) {
+    fprintf(stderr, "%s: %s after %llu rows\n", r->path, what, (unsigned long long)r->total);
+    return -1;
+}
+
+// Reads and checks the next block. Returns 1 with r->rows rows ready,
+// 0 at a consistent end of archive, -1 on damage.
+static inline int archive_next(ArchiveReader *r) {
+    unsigned char h[8];
+    if (!archive_read_all(r->fd, h, sizeof(h))) return archive_corrupt(r, "truncated");
+    uint32_t rows = get_le32(h), ncols = get_le32(h + 4);
+    if (ncols == 0 || ncols > ARCHIVE_MAX_COLS) return archive_corrupt(r, "bad block header");
+    r->raw.n = 0;
+    if (!archive_reserve(&r->raw, 8 + ncols * 9)) return archive_corrupt(r, "out of memory");
+    unsigned char *desc = r->raw.p + 8;
+    memcpy(r->raw.p, h, 8);
+    if (!archive_read_all(r->fd, desc, ncols * 9)) return archive_corrupt(r, "truncated");
+    size_t payload = 0;
+    for (unsigned c = 0; c < ncols; c++) {
+        const unsigned char *d = desc + c * 9;
+        uint32_t len = get_le32(d + 1), stored = get_le32(d + 5);
+        if (d[0] > ARCHIVE_LZ || len > ARCHIVE_COL_MAX || stored > lz_bound(len) ||
+            (d[0] == ARCHIVE_RAW && stored != len))
+            return archive_corrupt(r, "bad column header");
+        payload += stored;
+    }
+    r->raw.n = 8 + ncols * 9;
+    if (!archive_reserve(&r->raw, payload + 4)) return archive_corrupt(r, "out of memory");
+    desc = r->raw.p + 8;
+    unsigned char *p = r->raw.p + r->raw.n;
+    if (!archive_read_all(r->fd, p, payload + 4)) return archive_corrupt(r, "truncated");
+    if (get_le32(p + payload) != crc32_update(0, r->raw.p, r->raw.n + payload))
+        return archive_corrupt(r, "checksum mismatch");
+
+    for (unsigned c = 0; c < ncols; c++, desc += 9) {
+        ArchiveBuf *col = &r->col[c];
+        uint32_t len = get_le32(desc + 1), stored = get_le32(desc + 5);
+        col->n = 0;
+        if (!archive_reserve(col, len ? len : 1)) return archive_corrupt(r, "out of memory");
+        if (desc[0] == ARCHIVE_RAW) memcpy(col->p, p, len);
+        else if (!lz_decompress(p, stored, col->p, len)) return archive_corrupt(r, "bad compressed column");
+        p += stored;
+        r->at[c] = col->p;
+        r->end[c] = col->p + len;
+    }
+    r->ncols = ncols;
+    r->rows = rows;
+    r->bad = 0;
+    if (rows) {
+        r->total += rows;
+        return 1;
+    }
+    uint64_t total;
+    if (!varint_get(r->at[0], (size_t)(r->end[0] - r->at[0]), &total) || total != r->total)
+        return archive_corrupt(r, "row count mismatch");
+    return 0;
+}
+
+static inline uint64_t archive_get(ArchiveReader *r, unsigned c) {
+    uint64_t v = 0;
+    size_t n = c < r->ncols ? varint_get(r->at[c], (size_t)(r->end[c] - r->at[c]), &v) : 0;
+    if (!n) { r->bad = 1; return 0; }
+    r->at[c] += n;
+    return v;
+}
+
+// Length-prefixed text, pointing into the column (not NUL-terminated).
+static inline const char *archive_get_text(ArchiveReader *r, unsigned c, size_t *len) {
+    uint64_t n = archive_get(r, c);
+    if (r->bad || n > (uint64_t)(r->end[c] - r->at[c])) { r->bad = 1; *len = 0; return ""; }
+    const char *s = (const char *)r->at[c];
+    r->at[c] += n;
+    *len = (size_t)n;
+    return s;
+}
+
+// Next name in the archive's collection list: id either names one seen
+// before or is the next new one, whose text comes from `names_col`.
+static inline const char *archive_get_name(ArchiveReader *r, InternTable *names, uint64_t id, unsigned names_col) {
+    if (id == names->count) {
+        size_t n;
+        const char *s = archive_get_text(r, names_col, &n);
+        if (r->bad || intern_insert(names, s, n, 0) != id) { r->bad = 1; return NULL; }
+    }
+    const char *s = id < names->count ? intern_str(names, (uint32_t)id) : NULL;
+    if (!s) r->bad = 1;
+    return s;
+}
+
+// Id for a collection name, adding it to the archive's list (and to the
+// block's names column) the first time.
+static inline uint32_t archive_put_name(ArchiveWriter *w, InternTable *names, const char *s, size_t n, unsigned names_col) {
+    uint32_t before = names->count, id = intern_insert(names, s, n, 0);
+    if (id == INTERN_NONE) w->failed = 1;
+    else if (names->count != before) archive_text(w, names_col, s, n);
+    return id;
+}
+
+// ---------------------------------------------------
+// forenzo_state.json entries
+// ---------------------------------------------------
+// Lines in forenzo.c's entry layout are split into columns (fields keep
+// their JSON escapes); any other line (older layouts, raw quotes inside a
+// field, a torn last line) is kept verbatim, so import reproduces the log
+// byte for byte and its hash chain is unchanged. The pieces below mirror
+// format_entry().
+#define ENTRY_AT_WHEN        "{ \"when\": \""
+#define ENTRY_AT_TICK        "\", \"tick\": "
+#define ENTRY_AT_COLLECTION  ", \"collection\": \""
+#define ENTRY_AT_OBSERVATION "\", \"observation\": \""
+#define ENTRY_AT_SOLUTION    "\", \"solution\": \""
+#define ENTRY_AT_END         "\" }"
+#define ENTRY_WHEN_LEN       20     // 2025-09-20T14:33:12Z
+
+enum { ENTRY_COL_LAYOUT, ENTRY_COL_WHEN, ENTRY_COL_TICK, ENTRY_COL_COLLECTION, ENTRY_COL_NAMES,
+       ENTRY_COL_OBSERVATION, ENTRY_COL_SOLUTION, ENTRY_COL_VERBATIM, ENTRY_COLS };
+enum { ENTRY_LINE, ENTRY_VERBATIM, ENTRY_VERBATIM_UNTERMINATED };
+
+typedef struct {
+    int64_t when;
+    int tick;
+    const char *collection, *observation, *solution;
+    size_t collection_len, observation_len, solution_len;
+} ArchiveEntry;
+
+// Calendar seconds for "YYYY-MM-DDTHH:MM:SSZ", with no time zone
+// applied: the log writes local time, and this only has to round-trip.
+static inline int64_t archive_days(int64_t y, int m, int d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+}
+
+static inline void archive_when_str(int64_t t, char *out) {
+    int64_t days = (t >= 0 ? t : t - 86399) / 86400, sec = t - days * 86400;
+    int64_t z = days + 719468, era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100), mp = (5 * doy + 2) / 153;
+    int d = (int)(doy - (153 * mp + 2) / 5 + 1), m = (int)(mp < 10 ? mp + 3 : mp - 9);
+    int64_t y = yoe + era * 400 + (m <= 2);
+    unsigned f[6] = { (unsigned)((y % 10000 + 10000) % 10000), (unsigned)m, (unsigned)d,
+                      (unsigned)(sec / 3600), (unsigned)(sec / 60 % 60), (unsigned)(sec % 60) };
+    memcpy(out, "0000-00-00T00:00:00Z", ENTRY_WHEN_LEN + 1);
+    static const unsigned char at[6] = { 3, 6, 9, 12, 15, 18 };     // last digit of each field
+    for (int i = 0; i < 6; i++)
+        for (unsigned v = f[i], k = at[i]; v; v /= 10, k--) out[k] = (char)('0' + v % 10);
+}
+
+static inline int archive_digits(const char *s, int n) {
+    int v = 0;
+    for (int i = 0; i < n; i++) {
+        if (s[i] < '0' || s[i] > '9') return -1;
+        v = v * 10 + (s[i] - '0');
+    }
+    return v;
+}
+
+static inline int archive_parse_when(const char *s, int64_t *t) {
+    int y = archive_digits(s, 4), mo = archive_digits(s + 5, 2), d = archive_digits(s + 8, 2);
+    int h = archive_digits(s + 11, 2), mi = archive_digits(s + 14, 2), sec = archive_digits(s + 17, 2);
+    if (y < 0 || mo < 1 || mo > 12 || d < 1 || d > 31 || h < 0 || h > 23 || mi < 0 || mi > 59 || sec < 0 || sec > 59)
+        return 0;
+    *t = archive_days(y, mo, d) * 86400 + h * 3600 + mi * 60 + sec;
+    char back[ENTRY_WHEN_LEN + 1];
+    archive_when_str(*t, back);
+    return memcmp(back, s, ENTRY_WHEN_LEN) == 0;   // 02-30 and the like stay verbatim
+}
+
+static inline const char *archive_skip(const char *p, const char *end, const char *lit) {
+    size_t n = strlen(lit);
+    return (size_t)(end - p) >= n && memcmp(p, lit, n) == 0 ? p + n : NULL;
+}
+
+// First occurrence of lit in [p, end), or NULL.
+static inline const char *archive_find(const char *p, const char *end, const char *lit) {
+    size_t n = strlen(lit);
+    while ((size_t)(end - p) >= n && (p = memchr(p, lit[0], (size_t)(end - p) - n + 1))) {
+        if (memcmp(p, lit, n) == 0) return p;
+        p++;
+    }
+    return NULL;
+}
+
+// Splits one line (without its newline) into an entry, only when
+// archive_put_entry()'s pieces would rebuild exactly these bytes.
+static inline int archive_parse_entry(const char *line, size_t n, ArchiveEntry *e) {
+    const char *end = line + n, *p = archive_skip(line, end, ENTRY_AT_WHEN), *q;
+    if (!p || memchr(line, '\0', n) || end - p < ENTRY_WHEN_LEN || !archive_parse_when(p, &e->when)) return 0;
+    if (!(p = archive_skip(p + ENTRY_WHEN_LEN, end, ENTRY_AT_TICK))) return 0;
+    char *num_end;
+    long tick = strtol(p, &num_end, 10);
+    char back[16];
+    if (num_end == p || tick < INT32_MIN || tick > INT32_MAX) return 0;
+    if ((size_t)snprintf(back, sizeof(back), "%ld", tick) != (size_t)(num_end - p) || memcmp(back, p, (size_t)(num_end - p)))
+        return 0;   // "+3", "007"
+    e->tick = (int)tick;
+    if (!(p = archive_skip(num_end, end, ENTRY_AT_COLLECTION))) return 0;
+    if (!(q = archive_find(p, end, ENTRY_AT_OBSERVATION))) return 0;
+    e->collection = p;
+    e->collection_len = (size_t)(q - p);
+    p = q + strlen(ENTRY_AT_OBSERVATION);
+    if (!(q = archive_find(p, end, ENTRY_AT_SOLUTION))) return 0;
+    e->observation = p;
+    e->observation_len = (size_t)(q - p);
+    p = q + strlen(ENTRY_AT_SOLUTION);
+    size_t tail = strlen(ENTRY_AT_END);
+    if ((size_t)(end - p) < tail || memcmp(end - tail, ENTRY_AT_END, tail) != 0) return 0;
+    e->solution = p;
+    e->solution_len = (size_t)(end - tail - p);
+    return 1;
+}
+
+static inline void archive_put_entry(FILE *out, const char *when, int tick, const char *collection,
+                                     const char *observation, size_t observation_len,
+                                     const char *solution, size_t solution_len) {
+    fputs(ENTRY_AT_WHEN, out);
+    fputs(when, out);
+    fprintf(out, ENTRY_AT_TICK "%d" ENTRY_AT_COLLECTION, tick);
+    fputs(collection, out);
+    fputs(ENTRY_AT_OBSERVATION, out);
+    fwrite(observation, 1, observation_len, out);
+    fputs(ENTRY_AT_SOLUTION, out);
+    fwrite(solution, 1, solution_len, out);
+    fputs(ENTRY_AT_END "\n", out);
+}
+
+// Returns the entries archived, or -1.
+static inline long archive_export_entries(const char *log_path, const char *path) {
+    FILE *in = fopen(log_path, "r");
+    if (!in) { perror(log_path); return -1; }
+    ArchiveWriter w;
+    if (!archive_create(&w, path, ARCHIVE_ENTRIES, ENTRY_COLS)) { fclose(in); return -1; }
+    InternTable names = {0};
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    int64_t when = 0, tick = 0;
+    while (!w.failed && (len = getline(&line, &cap, in)) > 0) {
+        int terminated = line[len - 1] == '\n';
+        size_t n = (size_t)len - (size_t)terminated;
+        ArchiveEntry e;
+        if (terminated && archive_parse_entry(line, n, &e)) {
+            archive_varint(&w, ENTRY_COL_LAYOUT, ENTRY_LINE);
+            archive_varint(&w, ENTRY_COL_WHEN, zigzag(e.when - when));
+            archive_varint(&w, ENTRY_COL_TICK, zigzag(e.tick - tick));
+            when = e.when;
+            tick = e.tick;
+            uint32_t id = archive_put_name(&w, &names, e.collection, e.collection_len, ENTRY_COL_NAMES);
+            archive_varint(&w, ENTRY_COL_COLLECTION, id);
+            archive_text(&w, ENTRY_COL_OBSERVATION, e.observation, e.observation_len);
+            archive_text(&w, ENTRY_COL_SOLUTION, e.solution, e.solution_len);
+        } else {
+            archive_varint(&w, ENTRY_COL_LAYOUT, terminated ? ENTRY_VERBATIM : ENTRY_VERBATIM_UNTERMINATED);
+            archive_text(&w, ENTRY_COL_VERBATIM, line, n);
+        }
+        archive_row(&w);
+    }
+    int ok = !ferror(in);
+    if (!ok) perror(log_path);
+    free(line);
+    fclose(in);
+    intern_close(&names);
+    long rows = (long)(w.total + w.rows);
+    if (!ok) { archive_abort(&w); return -1; }
+    return archive_commit(&w) ? rows : -1;
+}
+
+// Recreates the log from an archive; refuses to touch a non-empty log.
+// Returns the entries restored, or -1.
+static inline long archive_import_entries(const char *path, const char *log_path) {
+    struct stat st;
+    if (stat(log_path, &st) == 0 && st.st_size > 0) {
+        fprintf(stderr, "%s already holds entries; import into an empty directory.\n", log_path);
+        return -1;
+    }
+    ArchiveReader r;
+    if (!archive_open(&r, path, ARCHIVE_ENTRIES)) return -1;
+    char tmp[1100];
+    snprintf(tmp, sizeof(tmp), "%s.import", log_path);
+    FILE *out = fopen(tmp, "w");
+    if (!out) { perror(tmp); archive_close(&r); return -1; }
+    static char outbuf[1 << 20];
+    setvbuf(out, outbuf, _IOFBF, sizeof(outbuf));
+    InternTable names = {0};
+    int64_t when = 0, tick = 0;
+    long n = 0;
+    int rc;
+    while ((rc = archive_next(&r)) > 0) {
+        for (uint32_t i = 0; i < r.rows && !r.bad; i++, n++) {
+            uint64_t layout = archive_get(&r, ENTRY_COL_LAYOUT);
+            size_t len, olen, slen;
+            if (layout == ENTRY_LINE) {
+                when += unzigzag(archive_get(&r, ENTRY_COL_WHEN));
+                tick += unzigzag(archive_get(&r, ENTRY_COL_TICK));
+                const char *collection = archive_get_name(&r, &names, archive_get(&r, ENTRY_COL_COLLECTION), ENTRY_COL_NAMES);
+                const char *observation = archive_get_text(&r, ENTRY_COL_OBSERVATION, &olen);
+                const char *solution = archive_get_text(&r, ENTRY_COL_SOLUTION, &slen);
+                if (r.bad) break;
+                char ts[ENTRY_WHEN_LEN + 1];
+                archive_when_str(when, ts);
+                archive_put_entry(out, ts, (int)tick, collection, observation, olen, solution, slen);
+            } else if (layout == ENTRY_VERBATIM || layout == ENTRY_VERBATIM_UNTERMINATED) {
+                const char *s = archive_get_text(&r, ENTRY_COL_VERBATIM, &len);
+                fwrite(s, 1, len, out);
+                if (layout == ENTRY_VERBATIM) fputc('\n', out);
+            } else {
+                r.bad = 1;
+            }
+        }
+        if (r.bad) { rc = archive_corrupt(&r, "malformed block"); break; }
+    }
+    int ok = rc == 0 && fflush(out) == 0 && fsync(fileno(out)) == 0;
+    ok = fclose(out) == 0 && ok;
+    if (ok && rename(tmp, log_path) != 0) { perror(log_path); ok = 0; }
+    if (!ok) unlink(tmp);
+    intern_close(&names);
+    archive_close(&r);
+    return ok ? n : -1;
+}
+
+// ---------------------------------------------------
+// forenzo.bin tokens
+// ---------------------------------------------------
+// Interned tokens are stored by text (collections through the name
+// list), so an import re-interns them into whatever dictionaries it
+// finds. Legacy tokens, and any whose ids the dictionaries cannot
+// resolve, keep their raw numbers. The flags column holds flags << 1,
+// with bit 0 set for those raw tokens.
+enum { TOKEN_COL_ID, TOKEN_COL_FLAGS, TOKEN_COL_COLLECTION, TOKEN_COL_NAMES,
+       TOKEN_COL_OBSERVATION, TOKEN_COL_SOLUTION, TOKEN_COLS };
+
+static inline long archive_export_tokens(const TokenStore *s, InternTable *collections,
+                                         InternTable *dictionary, const char *path) {
+    ArchiveWriter w;
+    if (!archive_create(&w, path, ARCHIVE_TOKENS, TOKEN_COLS)) return -1;
+    InternTable names = {0};
+    int64_t id = 0;
+    for (uint64_t i = 0; i < s->count && !w.failed; i++) {
+        const MemoryToken *t = &s->tokens[i];
+        const char *c = NULL, *o = NULL, *v = NULL;
+        if (t->flags & TOKEN_INTERNED) {
+            c = intern_str(collections, t->collection);
+            o = intern_str(dictionary, t->observation);
+            v = intern_str(dictionary, t->solution);
+        }
+        int raw = !c || !o || !v;
+        archive_varint(&w, TOKEN_COL_ID, zigzag((int64_t)t->id - id));
+        id = t->id;
+        archive_varint(&w, TOKEN_COL_FLAGS, (uint64_t)t->flags << 1 | (uint64_t)raw);
+        if (raw) {
+            archive_varint(&w, TOKEN_COL_COLLECTION, t->collection);
+            archive_varint(&w, TOKEN_COL_OBSERVATION, t->observation);
+            archive_varint(&w, TOKEN_COL_SOLUTION, t->solution);
+        } else {
+            archive_varint(&w, TOKEN_COL_COLLECTION, archive_put_name(&w, &names, c, strlen(c), TOKEN_COL_NAMES));
+            archive_text(&w, TOKEN_COL_OBSERVATION, o, strlen(o));
+            archive_text(&w, TOKEN_COL_SOLUTION, v, strlen(v));
+        }
+        archive_row(&w);
+    }
+    intern_close(&names);
+    long rows = (long)(w.total + w.rows);
+    return archive_commit(&w) ? rows : -1;
+}
+
+// Appends the archived tokens to an empty store. Returns tokens, or -1.
+static inline long archive_import_tokens(const char *path, TokenStore *s, InternTable *collections,
+                                         InternTable *dictionary) {
+    if (s->count) {
+        fprintf(stderr, "The memory store already holds %llu tokens; import into an empty directory.\n",
+                (unsigned long long)s->count);
+        return -1;
+    }
+    ArchiveReader r;
+    if (!archive_open(&r, path, ARCHIVE_TOKENS)) return -1;
+    InternTable names = {0};
+    int64_t id = 0;
+    long n = 0;
+    int rc;
+    while ((rc = archive_next(&r)) > 0) {
+        for (uint32_t i = 0; i < r.rows && !r.bad; i++, n++) {
+            MemoryToken t;
+            id += unzigzag(archive_get(&r, TOKEN_COL_ID));
+            uint64_t flags = archive_get(&r, TOKEN_COL_FLAGS);
+            t.id = (uint32_t)id;
+            t.flags = (uint16_t)(flags >> 1);
+            if (flags & 1) {
+                t.collection = (uint16_t)archive_get(&r, TOKEN_COL_COLLECTION);
+                t.observation = (uint32_t)archive_get(&r, TOKEN_COL_OBSERVATION);
+                t.solution = (uint32_t)archive_get(&r, TOKEN_COL_SOLUTION);
+            } else {
+                size_t olen, slen;
+                const char *c = archive_get_name(&r, &names, archive_get(&r, TOKEN_COL_COLLECTION), TOKEN_COL_NAMES);
+                const char *o = archive_get_text(&r, TOKEN_COL_OBSERVATION, &olen);
+                const char *v = archive_get_text(&r, TOKEN_COL_SOLUTION, &slen);
+                if (r.bad) break;
+                uint32_t cid = intern_id(collections, c);
+                t.observation = intern_insert(dictionary, o, olen, 1);
+                t.solution = intern_insert(dictionary, v, slen, 1);
+                if (cid == INTERN_NONE || t.observation == INTERN_NONE || t.solution == INTERN_NONE) {
+                    fprintf(stderr, "%s: could not add to the dictionary\n", path); r.bad = 1; break;
+                }
+                if (cid > 0xFFFF) { fprintf(stderr, "%s: more than 65536 collections\n", path); r.bad = 1; break; }
+                t.collection = (uint16_t)cid;
+            }
+            if (r.bad) break;
+            if (token_store_append(s, &t) < 0) { r.bad = 1; break; }
+        }
+        if (r.bad) { rc = archive_corrupt(&r, "malformed block"); break; }
+    }
+    intern_close(&names);
+    archive_close(&r);
+    return rc == 0 ? n : -1;
+}
+
+// File-level wrappers for programs that do not keep the store open
+// (forenzo_gov's export_eden / import_eden, forenzo_syslang's flags).
+static inline long archive_export_memory(const char *bin, const char *dict, const char *cdict, const char *path) {
+    TokenStore s;
+    InternTable d = {0}, c = {0};
+    if (access(bin, F_OK) != 0) { perror(bin); return -1; }
+    if (!token_store_open(&s, bin)) return -1;
+    long n = -1;
+    if (intern_open(&d, dict) && intern_open(&c, cdict)) n = archive_export_tokens(&s, &c, &d, path);
+    intern_close(&d);
+    intern_close(&c);
+    token_store_close(&s);
+    return n;
+}
+
+static inline long archive_import_memory(const char *path, const char *bin, const char *dict, const char *cdict) {
+    TokenStore s;
+    InternTable d = {0}, c = {0};
+    if (!token_store_open(&s, bin)) return -1;
+    long n = -1;
+    if (intern_open(&d, dict) && intern_open(&c, cdict)) n = archive_import_tokens(path, &s, &c, &d);
+    intern_close(&d);
+    intern_close(&c);
+    token_store_close(&s);
+    return n;
+}
+
+#endif // FORENZO_ARCHIVE_H
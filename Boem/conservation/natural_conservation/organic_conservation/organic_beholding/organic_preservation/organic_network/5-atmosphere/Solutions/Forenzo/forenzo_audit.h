@@ -0,0 +1,290 @@
+// forenzo_audit.h — asynchronous audit log (forenzo_activity.log)
+// Callers drop records into a bounded lock-free ring (multi-producer,
+// single-consumer, per-slot sequence numbers in the Vyukov style); one
+// writer thread drains it into large O_APPEND writes. A command pays for
+// a memcpy and two atomics, never for the file.
+//
+// When the ring is full the policy decides: AUDIT_BLOCK waits for the
+// writer to free a slot, AUDIT_DROP counts the record as dropped and
+// returns. Drops are reported in the log itself as "audit_dropped".
+// Records too long for a slot skip the ring and go out in one write(),
+// so they may land ahead of shorter records queued before them.
+
+#ifndef FORENZO_AUDIT_H
+#define FORENZO_AUDIT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <time.h>
+
+#define AUDIT_SLOT      512                 // bytes per slot, header included
+#define AUDIT_SLOT_DATA (AUDIT_SLOT - 16)   // longest record that fits
+#define AUDIT_BATCH     (256 * 1024)        // bytes per write()
+#define AUDIT_IDLE_MS   100                 // writer re-checks at least this often
+
+typedef enum { AUDIT_BLOCK, AUDIT_DROP } AuditOverflow;
+
+typedef struct {
+    unsigned slots;             // ring size, rounded up to a power of two
+    AuditOverflow overflow;
+} AuditPolicy;
+
+#define AUDIT_POLICY_DEFAULT ((AuditPolicy){ 2048, AUDIT_BLOCK })
+
+typedef struct {
+    _Atomic uint64_t seq;       // == position: free; position + 1: holds a record
+    uint32_t len;
+    char data[AUDIT_SLOT_DATA];
+} AuditSlot;
+
+typedef struct {
+    int fd;
+    char path[1024];
+    AuditPolicy policy;
+    AuditSlot *ring;
+    uint64_t mask;
+    _Atomic uint64_t head;      // next position a producer claims
+    uint64_t tail;              // next position the writer drains (writer only)
+    _Atomic uint64_t dropped;
+    uint64_t dropped_reported;  // writer only
+    _Atomic int idle;           // writer is (about to be) waiting on wake
+    _Atomic int waiting;        // producers blocked on a full ring
+    char *batch;
+    pthread_mutex_t lock;
+    pthread_cond_t wake, space;
+    pthread_t writer;
+    int running;
+    _Atomic int closing;
+} AuditLog;
+
+// ---------------------------------------------------
+// Timestamps
+// ---------------------------------------------------
+// The "ts" of a record the log writes itself or a caller composes:
+// UTC, so the trailing "Z" means what it says.
+static inline void audit_timestamp(char *ts, size_t cap) {
+    time_t t = time(NULL);
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(ts, cap, "%Y-%m-%dT%H:%M:%SZ", &tm);
+}
+
+// ---------------------------------------------------
+// Writer thread
+// ---------------------------------------------------
+static inline void audit_write_all(AuditLog *a, const char *buf, size_t n) {
+    while (n) {
+        ssize_t w = write(a->fd, buf, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            perror(a->path);
+            return;
+        }
+        buf += w;
+        n -= (size_t)w;
+    }
+}
+
+static inline int audit_ready(AuditLog *a) {
+    AuditSlot *s = &a->ring[a->tail & a->mask];
+    return atomic_load_explicit(&s->seq, memory_order_acquire) == a->tail + 1;
+}
+
+// Moves every published record into one buffer and writes it; returns
+// the number of records written.
+static inline size_t audit_drain(AuditLog *a) {
+    size_t len = 0, n = 0;
+    while (len + AUDIT_SLOT_DATA <= AUDIT_BATCH && audit_ready(a)) {
+        AuditSlot *s = &a->ring[a->tail & a->mask];
+        memcpy(a->batch + len, s->data, s->len);
+        len += s->len;
+        atomic_store_explicit(&s->seq, a->tail + a->mask + 1, memory_order_release);
+        a->tail++;
+        n++;
+    }
+    uint64_t dropped = atomic_load_explicit(&a->dropped, memory_order_relaxed);
+    if (dropped != a->dropped_reported && len + 128 <= AUDIT_BATCH) {
+        char ts[64];
+        audit_timestamp(ts, sizeof(ts));
+        len += (size_t)snprintf(a->batch + len, 128, "{\"ts\":\"%s\",\"event\":\"audit_dropped\",\"count\":%llu}\n",
+                                ts, (unsigned long long)(dropped - a->dropped_reported));
+        a->dropped_reported = dropped;
+    }
+    if (len) audit_write_all(a, a->batch, len);
+    if (n && atomic_load_explicit(&a->waiting, memory_order_acquire)) {
+        pthread_mutex_lock(&a->lock);
+        pthread_cond_broadcast(&a->space);
+        pthread_mutex_unlock(&a->lock);
+    }
+    return n;
+}
+
+static inline void *audit_writer_main(void *arg) {
+    AuditLog *a = arg;
+    for (;;) {
+        if (audit_drain(a)) continue;
+        if (atomic_load(&a->closing)) {
+            // producers are done; one last pass for records published
+            // between the drain and the flag
+            audit_drain(a);
+            break;
+        }
+        pthread_mutex_lock(&a->lock);
+        atomic_store(&a->idle, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!audit_ready(a) && !atomic_load(&a->closing)) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += AUDIT_IDLE_MS * 1000000L;
+            if (until.tv_nsec >= 1000000000L) { until.tv_sec++; until.tv_nsec -= 1000000000L; }
+            pthread_cond_timedwait(&a->wake, &a->lock, &until);
+        }
+        atomic_store(&a->idle, 0);
+        pthread_mutex_unlock(&a->lock);
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------
+// Open / Close
+// ---------------------------------------------------
+static inline int audit_open(AuditLog *a, const char *path, AuditPolicy policy) {
+    memset(a, 0, sizeof(*a));
+    snprintf(a->path, sizeof(a->path), "%s", path);
+    a->fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (a->fd < 0) { perror(path); return 0; }
+    unsigned slots = 2;
+    while (slots < policy.slots) slots <<= 1;
+    policy.slots = slots;
+    a->policy = policy;
+    a->mask = slots - 1;
+    a->ring = malloc((size_t)slots * sizeof(AuditSlot));
+    a->batch = malloc(AUDIT_BATCH);
+    if (!a->ring || !a->batch) {
+        free(a->ring);
+        free(a->batch);
+        close(a->fd);
+        a->fd = -1;
+        return 0;
+    }
+    for (uint64_t i = 0; i < slots; i++) atomic_init(&a->ring[i].seq, i);
+    pthread_mutex_init(&a->lock, NULL);
+    pthread_cond_init(&a->wake, NULL);
+    pthread_cond_init(&a->space, NULL);
+    // Without the thread every record is written in place.
+    a->running = pthread_create(&a->writer, NULL, audit_writer_main, a) == 0;
+    return 1;
+}
+
+// Writes out everything queued, then stops the writer.
+static inline void audit_close(AuditLog *a) {
+    if (a->fd < 0 || !a->ring) return;
+    if (a->running) {
+        pthread_mutex_lock(&a->lock);
+        atomic_store(&a->closing, 1);
+        pthread_cond_signal(&a->wake);
+        pthread_mutex_unlock(&a->lock);
+        pthread_join(a->writer, NULL);
+        a->running = 0;
+    }
+    pthread_mutex_destroy(&a->lock);
+    pthread_cond_destroy(&a->wake);
+    pthread_cond_destroy(&a->space);
+    free(a->ring);
+    free(a->batch);
+    a->ring = NULL;
+    a->batch = NULL;
+    close(a->fd);
+    a->fd = -1;
+}
+
+// ---------------------------------------------------
+// Recording
+// ---------------------------------------------------
+// Queues one record (a newline is added when missing). Returns 0 when
+// the log is closed or the record was dropped.
+static inline int audit_log(AuditLog *a, const char *rec, size_t n) {
+    if (!a->ring) return 0;
+    int nl = n == 0 || rec[n - 1] != '\n';
+    if (!a->running || n + nl > AUDIT_SLOT_DATA) {
+        struct iovec iov[2] = { { (void *)rec, n }, { "\n", (size_t)nl } };
+        return writev(a->fd, iov, 2) == (ssize_t)(n + nl);
+    }
+    uint64_t pos = atomic_load_explicit(&a->head, memory_order_relaxed);
+    AuditSlot *s;
+    for (;;) {
+        s = &a->ring[pos & a->mask];
+        uint64_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+        int64_t dif = (int64_t)(seq - pos);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&a->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (dif < 0) {
+            // full: the slot still holds the record from one lap ago
+            if (a->policy.overflow == AUDIT_DROP) {
+                atomic_fetch_add_explicit(&a->dropped, 1, memory_order_relaxed);
+                return 0;
+            }
+            pthread_mutex_lock(&a->lock);
+            atomic_fetch_add(&a->waiting, 1);
+            if (atomic_load_explicit(&s->seq, memory_order_acquire) == seq) {
+                pthread_cond_signal(&a->wake);
+                struct timespec until;
+                clock_gettime(CLOCK_REALTIME, &until);
+                until.tv_nsec += 1000000L;
+                if (until.tv_nsec >= 1000000000L) { until.tv_sec++; until.tv_nsec -= 1000000000L; }
+                pthread_cond_timedwait(&a->space, &a->lock, &until);
+            }
+            atomic_fetch_sub(&a->waiting, 1);
+            pthread_mutex_unlock(&a->lock);
+            pos = atomic_load_explicit(&a->head, memory_order_relaxed);
+        } else {
+            pos = atomic_load_explicit(&a->head, memory_order_relaxed);
+        }
+    }
+    memcpy(s->data, rec, n);
+    if (nl) s->data[n] = '\n';
+    s->len = (uint32_t)(n + nl);
+    atomic_store_explicit(&s->seq, pos + 1, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&a->idle, memory_order_relaxed)) {
+        pthread_mutex_lock(&a->lock);
+        pthread_cond_signal(&a->wake);
+        pthread_mutex_unlock(&a->lock);
+    }
+    return 1;
+}
+
+static inline int audit_logf(AuditLog *a, const char *fmt, ...) {
+    char stack[AUDIT_SLOT_DATA], *line = stack;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(stack, sizeof(stack), fmt, ap);
+    va_end(ap);
+    if (n < 0) return 0;
+    if ((size_t)n >= sizeof(stack)) {
+        if (!(line = malloc((size_t)n + 1))) return 0;
+        va_start(ap, fmt);
+        vsnprintf(line, (size_t)n + 1, fmt, ap);
+        va_end(ap);
+    }
+    int ok = audit_log(a, line, (size_t)n);
+    if (line != stack) free(line);
+    return ok;
+}
+
+static inline uint64_t audit_dropped(AuditLog *a) {
+    return atomic_load_explicit(&a->dropped, memory_order_relaxed);
+}
+
+#endif // FORENZO_AUDIT_H
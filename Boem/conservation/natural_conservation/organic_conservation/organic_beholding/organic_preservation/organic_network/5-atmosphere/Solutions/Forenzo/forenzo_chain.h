@@ -0,0 +1,157 @@
+// forenzo_chain.h — SHA-256 hash chain over forenzo_state.json entries
+// link[i] = SHA-256(link[i-1] || entry i's bytes, newline included),
+// with link[-1] = 32 zero bytes. The sidecar stores every link (32 bytes
+// each, in record order), so the head commits to the whole log and any
+// range of entries can be checked on its own: verification splits the
+// log into chunks and checks them on all cores at once.
+// The head is what push_hash.py anchors externally.
+
+#ifndef FORENZO_CHAIN_H
+#define FORENZO_CHAIN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "forenzo_log.h"
+#include "forenzo_endian.h"
+#include "forenzo_index.h"      // INDEX_RECORD_SIZE
+#include "forenzo_sha256.h"
+
+#define CHAIN_LINK_SIZE 32
+
+typedef struct {
+    LogWriter w;
+    uint64_t count;                     // links, including buffered ones
+    unsigned char head[CHAIN_LINK_SIZE];
+} HashChain;
+
+static inline void chain_link(const unsigned char prev[CHAIN_LINK_SIZE], const void *entry, size_t n,
+                              unsigned char out[CHAIN_LINK_SIZE]) {
+    Sha256 s;
+    sha256_init(&s);
+    sha256_update(&s, prev, CHAIN_LINK_SIZE);
+    sha256_update(&s, entry, n);
+    sha256_final(&s, out);
+}
+
+// Extend the chain with the next entry's exact bytes.
+static inline void chain_add(HashChain *c, const void *entry, size_t n) {
+    chain_link(c->head, entry, n, c->head);
+    log_writer_append(&c->w, c->head, CHAIN_LINK_SIZE, NULL);
+    c->count++;
+}
+
+// ---------------------------------------------------
+// Open / Close
+// ---------------------------------------------------
+// Keeps at most `records` links (dropping a torn tail) and loads the head.
+static inline int chain_open(HashChain *c, const char *path, uint64_t records, LogPolicy policy) {
+    memset(c, 0, sizeof(*c));
+    struct stat st;
+    if (stat(path, &st) == 0) {
+        uint64_t n = (uint64_t)st.st_size / CHAIN_LINK_SIZE;
+        if (n > records) n = records;
+        if ((uint64_t)st.st_size != n * CHAIN_LINK_SIZE && truncate(path, (off_t)(n * CHAIN_LINK_SIZE)) != 0)
+            perror("truncate hash chain");
+        if (n) {
+            int fd = open(path, O_RDONLY);
+            if (fd < 0 || pread(fd, c->head, CHAIN_LINK_SIZE, (off_t)((n - 1) * CHAIN_LINK_SIZE)) != CHAIN_LINK_SIZE)
+                n = 0, memset(c->head, 0, CHAIN_LINK_SIZE);
+            if (fd >= 0) close(fd);
+            if (!n && truncate(path, 0) != 0) perror("truncate hash chain");
+        }
+        c->count = n;
+    }
+    return log_writer_open(&c->w, path, policy);
+}
+
+static inline void chain_close(HashChain *c) {
+    log_writer_close(&c->w);
+    memset(c, 0, sizeof(*c));
+}
+
+// ---------------------------------------------------
+// Parallel verification
+// ---------------------------------------------------
+typedef struct {
+    const unsigned char *log, *idx, *links;
+    uint64_t log_size, count;
+    uint64_t first, end;        // this chunk's records
+    uint64_t bad;               // first failing record, or end
+    pthread_t tid;
+    int threaded;
+} ChainChunk;
+
+static inline void *chain_verify_chunk(void *arg) {
+    ChainChunk *k = arg;
+    static const unsigned char zero[CHAIN_LINK_SIZE];
+    unsigned char link[CHAIN_LINK_SIZE];
+    k->bad = k->end;
+    for (uint64_t i = k->first; i < k->end; i++) {
+        uint64_t off = get_le64(k->idx + i * INDEX_RECORD_SIZE);
+        uint64_t end = i + 1 < k->count ? get_le64(k->idx + (i + 1) * INDEX_RECORD_SIZE) : k->log_size;
+        if (off > end || end > k->log_size) { k->bad = i; break; }
+        chain_link(i ? k->links + (i - 1) * CHAIN_LINK_SIZE : zero, k->log + off, (size_t)(end - off), link);
+        if (memcmp(link, k->links + i * CHAIN_LINK_SIZE, CHAIN_LINK_SIZE) != 0) { k->bad = i; break; }
+    }
+    return NULL;
+}
+
+static inline void *chain_map(const char *path, uint64_t *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    void *m = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (m == MAP_FAILED) m = NULL;
+        *size = (uint64_t)st.st_size;
+    }
+    close(fd);
+    return m;
+}
+
+// Check the first `count` entries of log_path against the chain, using
+// the offset index to find entry boundaries. Returns the first record
+// whose link does not match, `count` when all match, or UINT64_MAX when
+// the files cannot be read. The caller flushes all three files first.
+static inline uint64_t chain_verify(const char *chain_path, const char *log_path, const char *idx_path,
+                                    uint64_t count, int nthreads) {
+    if (count == 0) return 0;
+    uint64_t log_size = 0, idx_size = 0, links_size = 0;
+    unsigned char *log = chain_map(log_path, &log_size);
+    unsigned char *idx = chain_map(idx_path, &idx_size);
+    unsigned char *links = chain_map(chain_path, &links_size);
+    uint64_t bad = UINT64_MAX;
+    if (log && idx && links) {
+        if (idx_size / INDEX_RECORD_SIZE < count) count = idx_size / INDEX_RECORD_SIZE;
+        uint64_t n = links_size / CHAIN_LINK_SIZE < count ? links_size / CHAIN_LINK_SIZE : count;
+        bad = n;                // a short sidecar fails at its first missing record
+        if (nthreads < 1) nthreads = 1;
+        if ((uint64_t)nthreads > n) nthreads = n ? (int)n : 1;
+        ChainChunk *k = calloc((size_t)nthreads, sizeof(ChainChunk));
+        for (int t = 0; k && t < nthreads; t++) {
+            k[t] = (ChainChunk){ .log = log, .idx = idx, .links = links, .log_size = log_size, .count = count,
+                                 .first = n * (uint64_t)t / (uint64_t)nthreads,
+                                 .end = n * (uint64_t)(t + 1) / (uint64_t)nthreads };
+            k[t].threaded = pthread_create(&k[t].tid, NULL, chain_verify_chunk, &k[t]) == 0;
+            if (!k[t].threaded) chain_verify_chunk(&k[t]);
+        }
+        for (int t = 0; k && t < nthreads; t++) if (k[t].threaded) pthread_join(k[t].tid, NULL);
+        for (int t = 0; k && t < nthreads; t++)
+            if (k[t].bad < k[t].end) { bad = k[t].bad; break; }
+        free(k);
+    }
+    if (log) munmap(log, (size_t)log_size);
+    if (idx) munmap(idx, (size_t)idx_size);
+    if (links) munmap(links, (size_t)links_size);
+    return bad;
+}
+
+#endif // FORENZO_CHAIN_H
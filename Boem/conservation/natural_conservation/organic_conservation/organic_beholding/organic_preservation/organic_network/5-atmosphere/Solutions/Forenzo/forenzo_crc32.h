@@ -0,0 +1,28 @@
+// forenzo_crc32.h — CRC-32 (IEEE 802.3, as zlib) for on-disk checksums
+// Incremental: crc32_update(crc32_update(0, a), b) == crc32 of a||b.
+
+#ifndef FORENZO_CRC32_H
+#define FORENZO_CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+static uint32_t crc32_table[256];
+
+static void crc32_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc32_table[i] = c;
+    }
+}
+
+static uint32_t crc32_update(uint32_t crc, const void *data, size_t n) {
+    const unsigned char *p = data;
+    if (!crc32_table[1]) crc32_init();
+    crc = ~crc;
+    while (n--) crc = crc32_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+#endif // FORENZO_CRC32_H
@@ -0,0 +1,196 @@
+// forenzo_index.h — sidecar offset/time index for forenzo_state.json
+// One fixed 16-byte little-endian record per log entry:
+//   u64 offset of the entry's line, i64 "when" as a Unix timestamp.
+// Lets reflect seek straight to the tail and answer last:N / since:<ts>
+// by binary search instead of rescanning the log.
+// Needs strptime(): define _GNU_SOURCE before any include on glibc.
+
+#ifndef FORENZO_INDEX_H
+#define FORENZO_INDEX_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "forenzo_log.h"
+#include "forenzo_endian.h"
+
+#define INDEX_RECORD_SIZE 16
+
+typedef struct {
+    LogWriter w;        // buffered appends, same policy as the log
+    int rfd;            // read side
+    uint64_t count;     // records, including buffered ones
+} StateIndex;
+
+// "2025-09-20T14:33:12Z" (local time, as written by now_str) or a raw
+// Unix timestamp. Returns -1 when nothing parses.
+static int64_t parse_when(const char *s) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char *end = strptime(s, "%Y-%m-%dT%H:%M:%S", &tm);
+    if (end) {
+        tm.tm_isdst = -1;
+        return (int64_t)mktime(&tm);
+    }
+    char *e;
+    long long v = strtoll(s, &e, 10);
+    return e != s ? (int64_t)v : -1;
+}
+
+static int64_t entry_when(const char *line) {
+    const char *p = strstr(line, "\"when\": \"");
+    return p ? parse_when(p + 9) : -1;
+}
+
+static uint32_t entry_hex4(const char *s) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        int c = s[i], d = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                          c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (d < 0) return UINT32_MAX;
+        v = v << 4 | (uint32_t)d;
+    }
+    return v;
+}
+
+// Copy the string value of "key" in an entry line (or any flat JSON
+// object) into out, undoing JSON escapes. Returns 0 when the key is absent.
+static int entry_field(const char *line, const char *key, char *out, size_t n) {
+    char pat[64];
+    snprintf(pat, sizeof(pat), "\"%s\"", key);
+    const char *p = line;
+    for (;; p++) {
+        if (!(p = strstr(p, pat)) || n == 0) return 0;
+        const char *v = p + strlen(pat);
+        while (*v == ' ' || *v == '\t') v++;
+        if (*v++ != ':') continue;
+        while (*v == ' ' || *v == '\t') v++;
+        if (*v == '"') { p = v + 1; break; }
+    }
+    size_t k = 0;
+    for (; *p && *p != '"'; p++) {
+        char c = *p;
+        if (c == '\\' && p[1]) {
+            c = *++p;
+            if (c == 'n') c = '\n';
+            else if (c == 't') c = '\t';
+            else if (c == 'r') c = '\r';
+            else if (c == 'b') c = '\b';
+            else if (c == 'f') c = '\f';
+            else if (c == 'u') {
+                uint32_t cp = entry_hex4(p + 1), lo;
+                if (cp == UINT32_MAX) continue;
+                p += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF && p[1] == '\\' && p[2] == 'u' &&
+                    (lo = entry_hex4(p + 3)) >= 0xDC00 && lo <= 0xDFFF) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    p += 6;
+                } else if (cp >= 0xD800 && cp <= 0xDFFF) {
+                    cp = 0xFFFD;
+                }
+                // UTF-8, never longer than the escape it came from
+                unsigned char u[4];
+                size_t len = cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+                if (len == 1) u[0] = (unsigned char)cp;
+                else {
+                    for (size_t i = len - 1; i > 0; i--, cp >>= 6) u[i] = (unsigned char)(0x80 | (cp & 0x3F));
+                    u[0] = (unsigned char)((0xF00 >> len) | cp);
+                }
+                if (k + len < n) { memcpy(out + k, u, len); k += len; }
+                continue;
+            }
+        }
+        if (k + 1 < n) out[k++] = c;
+    }
+    out[k] = '\0';
+    return 1;
+}
+
+// ---------------------------------------------------
+// Record access
+// ---------------------------------------------------
+static int state_index_get(StateIndex *ix, uint64_t i, uint64_t *offset, int64_t *when) {
+    unsigned char rec[INDEX_RECORD_SIZE];
+    if (i >= ix->count) return 0;
+    if (pread(ix->rfd, rec, sizeof(rec), (off_t)(i * INDEX_RECORD_SIZE)) != (ssize_t)sizeof(rec))
+        return 0;
+    if (offset) *offset = get_le64(rec);
+    if (when) *when = (int64_t)get_le64(rec + 8);
+    return 1;
+}
+
+static void state_index_add(StateIndex *ix, uint64_t offset, int64_t when) {
+    unsigned char rec[INDEX_RECORD_SIZE];
+    put_le64(rec, offset);
+    put_le64(rec + 8, (uint64_t)when);
+    if (log_writer_append(&ix->w, rec, sizeof(rec), NULL) == 0) ix->count++;
+}
+
+// First record whose timestamp is >= when (count if none).
+static uint64_t state_index_lower_bound(StateIndex *ix, int64_t when) {
+    uint64_t lo = 0, hi = ix->count;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        int64_t w = 0;
+        state_index_get(ix, mid, NULL, &w);
+        if (w < when) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+// ---------------------------------------------------
+// Open: validate against the log and index any unindexed tail
+// ---------------------------------------------------
+static int state_index_open(StateIndex *ix, const char *idx_path,
+                            const char *log_path, LogPolicy policy) {
+    memset(ix, 0, sizeof(*ix));
+    ix->rfd = open(idx_path, O_RDWR | O_CREAT, 0644);
+    if (ix->rfd < 0) { perror("open state index"); return 0; }
+
+    struct stat st;
+    uint64_t log_size = stat(log_path, &st) == 0 ? (uint64_t)st.st_size : 0;
+    fstat(ix->rfd, &st);
+    ix->count = (uint64_t)st.st_size / INDEX_RECORD_SIZE;
+
+    // Drop records that point past the log (index flushed before a crash)
+    uint64_t off = 0;
+    while (ix->count && (!state_index_get(ix, ix->count - 1, &off, NULL) || off >= log_size))
+        ix->count--;
+    if (ftruncate(ix->rfd, (off_t)(ix->count * INDEX_RECORD_SIZE)) != 0) {
+        perror("truncate state index");
+        return 0;
+    }
+    if (!log_writer_open(&ix->w, idx_path, policy)) return 0;
+
+    // Index entries appended while the index was missing or behind
+    FILE *f = fopen(log_path, "r");
+    if (!f) return 1;
+    int skip_first = ix->count > 0;
+    if (skip_first) fseeko(f, (off_t)off, SEEK_SET);
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t n;
+    off_t pos = ftello(f);
+    while ((n = getline(&line, &cap, f)) > 0) {
+        if (skip_first) skip_first = 0;
+        else state_index_add(ix, (uint64_t)pos, entry_when(line));
+        pos += n;
+    }
+    free(line);
+    fclose(f);
+    log_writer_flush(&ix->w);
+    return 1;
+}
+
+static void state_index_close(StateIndex *ix) {
+    log_writer_close(&ix->w);
+    if (ix->rfd >= 0) close(ix->rfd);
+    ix->rfd = -1;
+}
+
+#endif // FORENZO_INDEX_H
@@ -0,0 +1,204 @@
+// forenzo_ingest.h — bulk loader for grow records (forenzo --ingest)
+// A reader thread parses the input into batches while the caller's
+// thread appends them, so parsing overlaps with log writes. Accepts one
+// record per line, either
+//   [grow|]collection|observation|solution     (the REPL's grow syntax)
+//   {"collection": "...", "observation": "...", "solution": "..."}
+// Batches are recycled through a small bounded queue, so memory stays
+// flat however long the input is.
+
+#ifndef FORENZO_INGEST_H
+#define FORENZO_INGEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "forenzo_index.h"      // entry_field()
+
+#define INGEST_BATCH   4096     // records per batch
+#define INGEST_BATCHES 4        // batches in flight
+
+typedef void (*IngestSink)(void *ctx, const char *collection,
+                           const char *observation, const char *solution);
+
+typedef struct IngestBatch {
+    char *text;                 // NUL-separated fields, back to back
+    size_t len, cap;
+    uint32_t *fields;           // 3 offsets into text per record
+    uint32_t n;
+    struct IngestBatch *next;
+} IngestBatch;
+
+typedef struct {
+    FILE *in;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    IngestBatch *full, **full_tail;     // parsed, waiting for the appender
+    IngestBatch *free_list;
+    int done;
+    long records, rejected;
+} Ingest;
+
+// ---------------------------------------------------
+// Parsing (reader thread)
+// ---------------------------------------------------
+static inline int ingest_reserve(IngestBatch *b, size_t n) {
+    if (b->len + n <= b->cap) return 1;
+    size_t cap = b->cap ? b->cap : 256 * 1024;
+    while (cap < b->len + n) cap *= 2;
+    char *t = realloc(b->text, cap);
+    if (!t) return 0;
+    b->text = t;
+    b->cap = cap;
+    return 1;
+}
+
+// Append one field; control characters become spaces so a record can
+// never split a log line.
+static inline void ingest_put(IngestBatch *b, const char *s, size_t n) {
+    char *d = b->text + b->len;
+    for (size_t i = 0; i < n; i++) d[i] = (unsigned char)s[i] < 0x20 ? ' ' : s[i];
+    d[n] = '\0';
+    b->len += n + 1;
+}
+
+static inline int ingest_parse(IngestBatch *b, char *line, size_t L) {
+    while (L && (line[L-1] == '\n' || line[L-1] == '\r')) line[--L] = '\0';
+    if (L == 0) return 0;
+    if (!ingest_reserve(b, 3 * (L + 1))) return 0;
+    uint32_t *f = &b->fields[b->n * 3];
+
+    if (line[0] == '{') {
+        static const char *keys[3] = { "collection", "observation", "solution" };
+        for (int k = 0; k < 3; k++) {
+            f[k] = (uint32_t)b->len;
+            char *out = b->text + b->len;
+            if (!entry_field(line, keys[k], out, L + 1)) out[0] = '\0';
+            size_t n = strlen(out);
+            for (size_t i = 0; i < n; i++) if ((unsigned char)out[i] < 0x20) out[i] = ' ';
+            b->len += n + 1;
+        }
+        if (!b->text[f[0]] && !b->text[f[1]] && !b->text[f[2]]) { b->len = f[0]; return 0; }
+    } else {
+        char *p = strncmp(line, "grow|", 5) == 0 ? line + 5 : line;
+        for (int k = 0; k < 3; k++) {
+            char *sep = k < 2 && p ? strchr(p, '|') : NULL;
+            size_t n = !p ? 0 : sep ? (size_t)(sep - p) : strlen(p);
+            f[k] = (uint32_t)b->len;
+            ingest_put(b, p ? p : "", n);
+            p = sep ? sep + 1 : NULL;
+        }
+    }
+    b->n++;
+    return 1;
+}
+
+static inline IngestBatch *ingest_take_free(Ingest *g) {
+    pthread_mutex_lock(&g->lock);
+    while (!g->free_list) pthread_cond_wait(&g->changed, &g->lock);
+    IngestBatch *b = g->free_list;
+    g->free_list = b->next;
+    pthread_mutex_unlock(&g->lock);
+    b->n = 0;
+    b->len = 0;
+    b->next = NULL;
+    return b;
+}
+
+static inline void ingest_hand_over(Ingest *g, IngestBatch *b, int done) {
+    pthread_mutex_lock(&g->lock);
+    if (b) { *g->full_tail = b; g->full_tail = &b->next; }
+    if (done) g->done = 1;
+    pthread_cond_broadcast(&g->changed);
+    pthread_mutex_unlock(&g->lock);
+}
+
+static inline void *ingest_reader(void *arg) {
+    Ingest *g = arg;
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t L;
+    IngestBatch *b = ingest_take_free(g);
+    while ((L = getline(&line, &cap, g->in)) >= 0) {
+        if (ingest_parse(b, line, (size_t)L)) g->records++;
+        else if (L > 1) g->rejected++;
+        if (b->n == INGEST_BATCH) {
+            ingest_hand_over(g, b, 0);
+            b = ingest_take_free(g);
+        }
+    }
+    free(line);
+    if (b->n) ingest_hand_over(g, b, 1);
+    else {
+        pthread_mutex_lock(&g->lock);
+        b->next = g->free_list;
+        g->free_list = b;
+        pthread_mutex_unlock(&g->lock);
+        ingest_hand_over(g, NULL, 1);
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------
+// Driver (caller's thread appends)
+// ---------------------------------------------------
+static inline void ingest_release(Ingest *g, IngestBatch *batches) {
+    for (int i = 0; i < INGEST_BATCHES; i++) {
+        free(batches[i].text);
+        free(batches[i].fields);
+    }
+    pthread_cond_destroy(&g->changed);
+    pthread_mutex_destroy(&g->lock);
+}
+
+// Feeds every record in `in` to sink, one batch at a time. Returns the
+// number of records; *rejected counts non-empty lines that did not parse.
+static inline long ingest_stream(FILE *in, IngestSink sink, void *ctx, long *rejected) {
+    Ingest g;
+    memset(&g, 0, sizeof(g));
+    g.in = in;
+    g.full_tail = &g.full;
+    pthread_mutex_init(&g.lock, NULL);
+    pthread_cond_init(&g.changed, NULL);
+    IngestBatch batches[INGEST_BATCHES];
+    memset(batches, 0, sizeof(batches));
+    for (int i = 0; i < INGEST_BATCHES; i++) {
+        batches[i].fields = malloc(INGEST_BATCH * 3 * sizeof(uint32_t));
+        if (!batches[i].fields) { ingest_release(&g, batches); return -1; }
+        batches[i].next = g.free_list;
+        g.free_list = &batches[i];
+    }
+
+    pthread_t reader;
+    if (pthread_create(&reader, NULL, ingest_reader, &g) != 0) { ingest_release(&g, batches); return -1; }
+    for (;;) {
+        pthread_mutex_lock(&g.lock);
+        while (!g.full && !g.done) pthread_cond_wait(&g.changed, &g.lock);
+        IngestBatch *b = g.full;
+        if (b) {
+            g.full = b->next;
+            if (!g.full) g.full_tail = &g.full;
+        }
+        pthread_mutex_unlock(&g.lock);
+        if (!b) break;
+
+        for (uint32_t i = 0; i < b->n; i++) {
+            const uint32_t *f = &b->fields[i * 3];
+            sink(ctx, b->text + f[0], b->text + f[1], b->text + f[2]);
+        }
+
+        pthread_mutex_lock(&g.lock);
+        b->next = g.free_list;
+        g.free_list = b;
+        pthread_cond_broadcast(&g.changed);
+        pthread_mutex_unlock(&g.lock);
+    }
+    pthread_join(reader, NULL);
+    ingest_release(&g, batches);
+    if (rejected) *rejected = g.rejected;
+    return g.records;
+}
+
+#endif // FORENZO_INGEST_H
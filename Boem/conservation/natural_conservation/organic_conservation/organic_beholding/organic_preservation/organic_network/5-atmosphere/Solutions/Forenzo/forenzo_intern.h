@@ -0,0 +1,237 @@
+// forenzo_intern.h — persistent string interning (Forenzo dictionary)
+// Every distinct string gets a dense id (0, 1, 2, …) with reverse lookup.
+// Strings live back to back in one arena; lookups go through an
+// open-addressing table of ids keyed by a 64-bit FNV-1a hash.
+// On disk the dictionary is append-only: u32 little-endian length + bytes
+// per new string, in id order, so reloading reproduces the same ids.
+// A snapshot section (forenzo_snapshot.h) holds the whole table, so
+// start-up copies it in and reads only the strings added since.
+
+#ifndef FORENZO_INTERN_H
+#define FORENZO_INTERN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "forenzo_log.h"
+#include "forenzo_endian.h"
+#include "forenzo_snapshot.h"
+
+#define INTERN_NONE UINT32_MAX
+
+typedef struct {
+    char *arena;                // NUL-terminated strings, back to back
+    size_t arena_len, arena_cap;
+    uint64_t *offsets;          // id -> arena offset
+    uint64_t *hashes;           // id -> hash (cheap compares and rehash)
+    uint32_t count, ids_cap;
+    uint32_t *slots;            // id + 1, 0 = empty
+    uint32_t slot_mask;
+    LogWriter w;                // persistence (unopened = in-memory only)
+} InternTable;
+
+static inline uint64_t intern_hash(const char *s, size_t n) {
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < n; i++) h = (h ^ (unsigned char)s[i]) * 1099511628211ull;
+    return h;
+}
+
+static inline const char *intern_str(const InternTable *t, uint32_t id) {
+    return id < t->count ? t->arena + t->offsets[id] : NULL;
+}
+
+// ---------------------------------------------------
+// Lookup / Insert
+// ---------------------------------------------------
+static inline uint32_t *intern_slot(InternTable *t, const char *s, size_t n, uint64_t h) {
+    for (uint32_t i = (uint32_t)h & t->slot_mask;; i = (i + 1) & t->slot_mask) {
+        uint32_t *slot = &t->slots[i];
+        if (!*slot) return slot;
+        uint32_t id = *slot - 1;
+        if (t->hashes[id] == h && strncmp(t->arena + t->offsets[id], s, n) == 0 &&
+            t->arena[t->offsets[id] + n] == '\0')
+            return slot;
+    }
+}
+
+static inline int intern_rehash(InternTable *t, uint32_t nslots) {
+    uint32_t *slots = calloc(nslots, sizeof(uint32_t));
+    if (!slots) return 0;
+    free(t->slots);
+    t->slots = slots;
+    t->slot_mask = nslots - 1;
+    for (uint32_t id = 0; id < t->count; id++) {
+        uint32_t i = (uint32_t)t->hashes[id] & t->slot_mask;
+        while (t->slots[i]) i = (i + 1) & t->slot_mask;
+        t->slots[i] = id + 1;
+    }
+    return 1;
+}
+
+static inline uint32_t intern_insert(InternTable *t, const char *s, size_t n, int persist) {
+    if (!t->slots && !intern_rehash(t, 1024)) return INTERN_NONE;
+    uint64_t h = intern_hash(s, n);
+    uint32_t *slot = intern_slot(t, s, n, h);
+    if (*slot) return *slot - 1;
+
+    if (t->count == t->ids_cap) {
+        uint32_t cap = t->ids_cap ? t->ids_cap * 2 : 1024;
+        uint64_t *o = realloc(t->offsets, cap * sizeof(uint64_t));
+        if (!o) return INTERN_NONE;
+        t->offsets = o;
+        uint64_t *hs = realloc(t->hashes, cap * sizeof(uint64_t));
+        if (!hs) return INTERN_NONE;
+        t->hashes = hs;
+        t->ids_cap = cap;
+    }
+    if (t->arena_len + n + 1 > t->arena_cap) {
+        size_t cap = t->arena_cap ? t->arena_cap * 2 : 64 * 1024;
+        while (cap < t->arena_len + n + 1) cap *= 2;
+        char *a = realloc(t->arena, cap);
+        if (!a) return INTERN_NONE;
+        t->arena = a;
+        t->arena_cap = cap;
+    }
+    // on file first: ids are positions there, so one kept only in memory
+    // would shift every later id after a restart
+    if (persist && t->w.buf) {
+        unsigned char *rec = malloc(n + 4);
+        if (!rec) return INTERN_NONE;
+        put_le32(rec, (uint32_t)n);
+        memcpy(rec + 4, s, n);
+        int rc = log_writer_append(&t->w, rec, n + 4, NULL);
+        free(rec);
+        if (rc != 0) return INTERN_NONE;
+    }
+    uint32_t id = t->count++;
+    memcpy(t->arena + t->arena_len, s, n);
+    t->arena[t->arena_len + n] = '\0';
+    t->offsets[id] = t->arena_len;
+    t->hashes[id] = h;
+    t->arena_len += n + 1;
+    *slot = id + 1;
+
+    if ((uint64_t)t->count * 2 > t->slot_mask) intern_rehash(t, (t->slot_mask + 1) * 2);
+    return id;
+}
+
+// Id for s, adding it to the dictionary if new.
+static inline uint32_t intern_id(InternTable *t, const char *s) {
+    return intern_insert(t, s, strlen(s), 1);
+}
+
+// Id for s if already known, else INTERN_NONE.
+static inline uint32_t intern_find(InternTable *t, const char *s) {
+    if (!t->slots) return INTERN_NONE;
+    size_t n = strlen(s);
+    uint32_t *slot = intern_slot(t, s, n, intern_hash(s, n));
+    return *slot ? *slot - 1 : INTERN_NONE;
+}
+
+// ---------------------------------------------------
+// Open / Close
+// ---------------------------------------------------
+static inline void intern_close(InternTable *t) {
+    log_writer_close(&t->w);
+    free(t->arena);
+    free(t->offsets);
+    free(t->hashes);
+    free(t->slots);
+    memset(t, 0, sizeof(*t));
+}
+
+// Bytes of the dictionary file holding t's strings.
+static inline off_t intern_file_size(const InternTable *t) {
+    return (off_t)(t->arena_len + 3 * (uint64_t)t->count);    // u32 length for a NUL each
+}
+
+// New strings are flushed immediately: tokens refer to them by id, so a
+// dictionary entry must never be lost while a token using it survives.
+// Loads the file into t (fresh, or filled by intern_restore), reading
+// only the strings t does not hold yet.
+static inline int intern_open(InternTable *t, const char *path) {
+    FILE *f = fopen(path, "rb");
+    off_t good = intern_file_size(t), size = 0;
+    struct stat st;
+    if (f && fstat(fileno(f), &st) == 0) size = st.st_size;
+    if (good > size || (f && fseeko(f, good, SEEK_SET) != 0)) {
+        intern_close(t);        // the file lost strings: it wins
+        good = 0;
+        if (f) rewind(f);
+    }
+    if (!f) return log_writer_open(&t->w, path, (LogPolicy){ 1, 0, 0 });
+    unsigned char len[4];
+    char *s = NULL;
+    size_t cap = 0;
+    while (fread(len, 1, 4, f) == 4) {
+        size_t n = get_le32(len);
+        if ((off_t)n > size - good - 4) break;         // torn tail
+        if (n + 1 > cap) {
+            char *grown = realloc(s, n + 1);
+            if (!grown) goto oom;
+            s = grown;
+            cap = n + 1;
+        }
+        if (fread(s, 1, n, f) != n) break;
+        if (intern_insert(t, s, n, 0) == INTERN_NONE) goto oom;
+        good += (off_t)(n + 4);
+    }
+    free(s);
+    fclose(f);
+    if (truncate(path, good) != 0) perror("truncate dictionary");   // drop a torn tail
+    return log_writer_open(&t->w, path, (LogPolicy){ 1, 0, 0 });
+oom:
+    // the file is left alone: later ids depend on every entry in it
+    perror(path);
+    free(s);
+    fclose(f);
+    intern_close(t);
+    return 0;
+}
+
+// ---------------------------------------------------
+// Snapshot section: u32 count, u32 nslots, u64 arena_len, arena bytes,
+// u64 offsets[count], u64 hashes[count], u32 slots[nslots]
+// ---------------------------------------------------
+static inline void intern_snapshot(const InternTable *t, SnapWriter *w, uint32_t tag) {
+    uint32_t nslots = t->slots ? t->slot_mask + 1 : 0;
+    snap_section(w, tag, 16 + t->arena_len + 16 * (uint64_t)t->count + 4 * (uint64_t)nslots);
+    snap_u32(w, t->count);
+    snap_u32(w, nslots);
+    snap_u64(w, t->arena_len);
+    snap_write(w, t->arena, t->arena_len);
+    for (uint32_t id = 0; id < t->count; id++) snap_u64(w, t->offsets[id]);
+    for (uint32_t id = 0; id < t->count; id++) snap_u64(w, t->hashes[id]);
+    for (uint32_t i = 0; i < nslots; i++) snap_u32(w, t->slots[i]);
+}
+
+// Fill a fresh table from a snapshot section.
+static inline int intern_restore(InternTable *t, const unsigned char *d, uint64_t len) {
+    if (len < 16) return 0;
+    uint32_t count = get_le32(d), nslots = get_le32(d + 4);
+    uint64_t alen = get_le64(d + 8);
+    if (alen > len - 16 || (len - 16 - alen) / 16 < count ||
+        16 + alen + 16 * (uint64_t)count + 4 * (uint64_t)nslots != len ||
+        (nslots & (nslots - 1)) || (uint64_t)count * 2 > nslots || (alen && d[16 + alen - 1]))
+        return 0;
+    if (!count) return 1;
+    t->arena = malloc(alen);
+    t->offsets = malloc(count * sizeof(uint64_t));
+    t->hashes = malloc(count * sizeof(uint64_t));
+    t->slots = malloc(nslots * sizeof(uint32_t));
+    if (!t->arena || !t->offsets || !t->hashes || !t->slots) return 0;
+    memcpy(t->arena, d + 16, alen);
+    t->arena_len = t->arena_cap = alen;
+    const unsigned char *p = d + 16 + alen;
+    for (uint32_t id = 0; id < count; id++, p += 8)
+        if ((t->offsets[id] = get_le64(p)) >= alen) return 0;
+    for (uint32_t id = 0; id < count; id++, p += 8) t->hashes[id] = get_le64(p);
+    for (uint32_t i = 0; i < nslots; i++, p += 4)
+        if ((t->slots[i] = get_le32(p)) > count) return 0;
+    t->count = t->ids_cap = count;
+    t->slot_mask = nslots - 1;
+    return 1;
+}
+
+#endif // FORENZO_INTERN_H
@@ -0,0 +1,272 @@
+// forenzo_json.h — streaming JSON writer into a caller's buffer
+// Builds one document in a preallocated buffer (no malloc, no stdio),
+// escaping every string, then hands it to the file or fd in one write().
+// Strings are escaped per RFC 8259; bytes that are not valid UTF-8
+// become U+FFFD, so the output always parses.
+//
+//   static char buf[64 * 1024];
+//   JsonWriter j;
+//   json_init(&j, buf, sizeof(buf));
+//   json_begin_object(&j);
+//   json_kv_str(&j, "when", ts);
+//   json_key(&j, "sender"); json_begin_inline(&j); ... json_end_object(&j);
+//   json_end_object(&j);
+//   json_write_file(path, &j, 0);
+//
+// Layout follows the hand-written files it replaces: two-space indents,
+// "key": value, with json_begin_inline() for { "a": 1, "b": 2 } objects
+// and json_begin_array_inline() for ["x", "y"] arrays. Activity log
+// records use json_begin_compact(): {"ts":"...","event":"..."}.
+
+#ifndef FORENZO_JSON_H
+#define FORENZO_JSON_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define JSON_MAX_DEPTH 32
+
+typedef struct {
+    char *buf;
+    size_t len, cap;
+    int depth;
+    int overflow;                           // ran out of room or nesting
+    unsigned char count[JSON_MAX_DEPTH];    // members so far (saturates at 1)
+    unsigned char inline_[JSON_MAX_DEPTH];  // container on one line
+    unsigned char object[JSON_MAX_DEPTH];   // object (vs array)
+    unsigned char compact[JSON_MAX_DEPTH];  // on one line, no spaces
+    int after_key;
+} JsonWriter;
+
+static inline void json_init(JsonWriter *j, char *buf, size_t cap) {
+    memset(j, 0, sizeof(*j));
+    j->buf = buf;
+    j->cap = cap;
+}
+
+// ---------------------------------------------------
+// Raw output
+// ---------------------------------------------------
+static inline void json_put(JsonWriter *j, const char *s, size_t n) {
+    if (j->overflow || n > j->cap - j->len) { j->overflow = 1; return; }
+    memcpy(j->buf + j->len, s, n);
+    j->len += n;
+}
+
+static inline void json_putc(JsonWriter *j, char c) {
+    if (j->overflow || j->len == j->cap) { j->overflow = 1; return; }
+    j->buf[j->len++] = c;
+}
+
+static inline void json_indent(JsonWriter *j) {
+    static const char spaces[] = "                                                                ";
+    size_t n = (size_t)j->depth * 2;
+    json_putc(j, '\n');
+    json_put(j, spaces, n < sizeof(spaces) - 1 ? n : sizeof(spaces) - 1);
+}
+
+// Separator and indentation before a value or key at the current level.
+static inline void json_next(JsonWriter *j) {
+    if (j->after_key) { j->after_key = 0; return; }
+    if (j->depth == 0) return;
+    int d = j->depth - 1, first = !j->count[d];
+    if (!first) json_putc(j, ',');
+    j->count[d] = 1;
+    if (!j->inline_[d]) json_indent(j);
+    else if (!j->compact[d] && (j->object[d] || !first)) json_putc(j, ' ');
+}
+
+// ---------------------------------------------------
+// Strings
+// ---------------------------------------------------
+// Length of the valid UTF-8 sequence at s (at most n bytes), or 0.
+static inline size_t json_utf8_len(const unsigned char *s, size_t n) {
+    unsigned c = s[0];
+    size_t len;
+    uint32_t cp;
+    if (c >= 0xC2 && c <= 0xDF) { len = 2; cp = c & 0x1F; }
+    else if (c >= 0xE0 && c <= 0xEF) { len = 3; cp = c & 0x0F; }
+    else if (c >= 0xF0 && c <= 0xF4) { len = 4; cp = c & 0x07; }
+    else return 0;
+    if (n < len) return 0;
+    for (size_t i = 1; i < len; i++) {
+        if ((s[i] & 0xC0) != 0x80) return 0;
+        cp = cp << 6 | (s[i] & 0x3F);
+    }
+    if ((len == 3 && (cp < 0x800 || (cp >= 0xD800 && cp <= 0xDFFF))) ||
+        (len == 4 && (cp < 0x10000 || cp > 0x10FFFF)))
+        return 0;
+    return len;
+}
+
+// Quoted and escaped; runs of plain bytes are copied in one go.
+static inline void json_stringn(JsonWriter *j, const char *str, size_t n) {
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char *s = (const unsigned char *)str, *run = s, *end = s + n;
+    json_next(j);
+    json_putc(j, '"');
+    while (s < end) {
+        unsigned c = *s;
+        if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\') { s++; continue; }
+        if (c >= 0x80) {
+            size_t len = json_utf8_len(s, (size_t)(end - s));
+            if (len) { s += len; continue; }
+        }
+        json_put(j, (const char *)run, (size_t)(s - run));
+        char esc[7] = { '\\', 0 };
+        size_t elen = 2;
+        switch (c) {
+            case '"':  esc[1] = '"'; break;
+            case '\\': esc[1] = '\\'; break;
+            case '\n': esc[1] = 'n'; break;
+            case '\r': esc[1] = 'r'; break;
+            case '\t': esc[1] = 't'; break;
+            case '\b': esc[1] = 'b'; break;
+            case '\f': esc[1] = 'f'; break;
+            default:
+                if (c >= 0x80) { memcpy(esc, "\\ufffd", 6); }
+                else { memcpy(esc, "\\u00", 4); esc[4] = hex[c >> 4]; esc[5] = hex[c & 15]; }
+                elen = 6;
+        }
+        json_put(j, esc, elen);
+        run = ++s;
+    }
+    json_put(j, (const char *)run, (size_t)(s - run));
+    json_putc(j, '"');
+}
+
+static inline void json_string(JsonWriter *j, const char *s) {
+    if (!s) s = "";
+    json_stringn(j, s, strlen(s));
+}
+
+// ---------------------------------------------------
+// Values and containers
+// ---------------------------------------------------
+static inline void json_key(JsonWriter *j, const char *key) {
+    json_string(j, key);
+    if (j->depth && j->compact[j->depth - 1]) json_putc(j, ':');
+    else json_put(j, ": ", 2);
+    j->after_key = 1;
+}
+
+static inline void json_int(JsonWriter *j, long long v) {
+    char tmp[24];
+    int n = snprintf(tmp, sizeof(tmp), "%lld", v);
+    json_next(j);
+    json_put(j, tmp, (size_t)n);
+}
+
+static inline void json_bool(JsonWriter *j, int v) {
+    json_next(j);
+    if (v) json_put(j, "true", 4);
+    else json_put(j, "false", 5);
+}
+
+static inline void json_null(JsonWriter *j) {
+    json_next(j);
+    json_put(j, "null", 4);
+}
+
+static inline void json_open(JsonWriter *j, char c, int object, int on_one_line, int compact) {
+    json_next(j);
+    json_putc(j, c);
+    if (j->depth == JSON_MAX_DEPTH) { j->overflow = 1; return; }
+    int outer = j->depth - 1;
+    j->count[j->depth] = 0;
+    j->object[j->depth] = (unsigned char)object;
+    j->compact[j->depth] = (unsigned char)(compact || (outer >= 0 && j->compact[outer]));
+    j->inline_[j->depth] = (unsigned char)(on_one_line || j->compact[j->depth] || (outer >= 0 && j->inline_[outer]));
+    j->depth++;
+}
+
+static inline void json_close(JsonWriter *j, char c) {
+    if (j->depth == 0) { j->overflow = 1; return; }
+    int d = --j->depth;
+    if (j->count[d]) {
+        if (!j->inline_[d]) json_indent(j);
+        else if (j->object[d] && !j->compact[d]) json_putc(j, ' ');
+    }
+    json_putc(j, c);
+}
+
+static inline void json_begin_object(JsonWriter *j)       { json_open(j, '{', 1, 0, 0); }
+static inline void json_begin_inline(JsonWriter *j)       { json_open(j, '{', 1, 1, 0); }
+static inline void json_begin_compact(JsonWriter *j)      { json_open(j, '{', 1, 1, 1); }
+static inline void json_end_object(JsonWriter *j)         { json_close(j, '}'); }
+static inline void json_begin_array(JsonWriter *j)        { json_open(j, '[', 0, 0, 0); }
+static inline void json_begin_array_inline(JsonWriter *j) { json_open(j, '[', 0, 1, 0); }
+static inline void json_end_array(JsonWriter *j)          { json_close(j, ']'); }
+
+static inline void json_kv_str(JsonWriter *j, const char *key, const char *v) { json_key(j, key); json_string(j, v); }
+static inline void json_kv_int(JsonWriter *j, const char *key, long long v)  { json_key(j, key); json_int(j, v); }
+static inline void json_kv_bool(JsonWriter *j, const char *key, int v)       { json_key(j, key); json_bool(j, v); }
+
+// ---------------------------------------------------
+// Output
+// ---------------------------------------------------
+// Closes the document with a newline; returns its length, or 0 when it
+// did not fit (or is unbalanced) and must not be written.
+static inline size_t json_finish(JsonWriter *j) {
+    json_putc(j, '\n');
+    return j->overflow || j->depth ? 0 : j->len;
+}
+
+static inline int json_write_all(int fd, const char *buf, size_t n) {
+    for (size_t off = 0; off < n;) {
+        ssize_t w = write(fd, buf + off, n - off);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        off += (size_t)w;
+    }
+    return 1;
+}
+
+static inline int json_write_fd(int fd, JsonWriter *j) {
+    size_t n = json_finish(j);
+    if (n == 0) { errno = ENOSPC; return 0; }
+    return json_write_all(fd, j->buf, n);
+}
+
+// Replaces path with the document: written to a hidden ".name.tmp"
+// beside it and renamed over it, so readers see either the old document
+// or the whole new one. With durable set the file is fsynced before the
+// rename and its directory after it, so the new document also survives
+// a crash; that costs a disk flush per call and is off unless asked for.
+// Nothing is touched when the document did not fit. On failure errno
+// says why.
+static inline int json_write_file(const char *path, JsonWriter *j, int durable) {
+    size_t n = json_finish(j);
+    if (n == 0) { errno = ENOSPC; return 0; }
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    char tmp[1040];
+    int len = snprintf(tmp, sizeof(tmp), "%.*s.%s.tmp", (int)(base - path), path, base);
+    if (len < 0 || (size_t)len >= sizeof(tmp)) { errno = ENAMETOOLONG; return 0; }
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return 0;
+    int ok = json_write_all(fd, j->buf, n) && (!durable || fsync(fd) == 0);
+    int err = errno;
+    if (close(fd) != 0 && ok) { ok = 0; err = errno; }
+    if (ok && rename(tmp, path) != 0) { ok = 0; err = errno; }
+    if (!ok) { unlink(tmp); errno = err; return 0; }
+    if (durable) {
+        char dir[1040];
+        snprintf(dir, sizeof(dir), "%.*s", base > path ? (int)(base - path) : 1, base > path ? path : ".");
+        int dfd = open(dir, O_RDONLY | O_DIRECTORY);
+        if (dfd < 0) return 0;
+        ok = fsync(dfd) == 0;
+        err = errno;
+        close(dfd);
+        errno = err;
+    }
+    return ok;
+}
+
+#endif // FORENZO_JSON_H
@@ -0,0 +1,174 @@
+// forenzo_log.h — group-commit writer for Forenzo's append-only logs
+// Keeps the log open, batches records in memory and flushes them
+// (optionally with fsync) every N records, every T ms, or on demand.
+// Header-only so each program still builds with a single clang line.
+
+#ifndef FORENZO_LOG_H
+#define FORENZO_LOG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+
+// ---------------------------------------------------
+// Flush policy
+// ---------------------------------------------------
+typedef struct {
+    unsigned flush_every;   // flush after this many records (0 = never by count)
+    unsigned flush_ms;      // flush records older than this (0 = never by time)
+    int      fsync;         // fsync after each flush
+} LogPolicy;
+
+#define LOG_POLICY_DEFAULT ((LogPolicy){ 64, 200, 0 })
+#define LOG_BUF_INITIAL    (64 * 1024)
+
+typedef struct {
+    int fd;
+    LogPolicy policy;
+    char *buf;
+    size_t len, cap;
+    unsigned pending;            // records buffered since the last flush
+    uint64_t size;               // file size including buffered bytes
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t flusher;
+    int flusher_running;
+    int closing;
+} LogWriter;
+
+// ---------------------------------------------------
+// Flush (caller holds the lock)
+// ---------------------------------------------------
+static int log_writer_flush_locked(LogWriter *w) {
+    size_t off = 0;
+    while (off < w->len) {
+        ssize_t n = write(w->fd, w->buf + off, w->len - off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("write state log");
+            memmove(w->buf, w->buf + off, w->len - off);
+            w->len -= off;
+            return -1;
+        }
+        off += (size_t)n;
+    }
+    w->len = 0;
+    w->pending = 0;
+    if (w->policy.fsync) {
+#ifdef F_FULLFSYNC
+        // macOS: plain fsync() does not reach the platters
+        if (fcntl(w->fd, F_FULLFSYNC) == -1) fsync(w->fd);
+#else
+        fsync(w->fd);
+#endif
+    }
+    return 0;
+}
+
+static int log_writer_flush(LogWriter *w) {
+    if (!w->buf) return 0;
+    pthread_mutex_lock(&w->lock);
+    int rc = log_writer_flush_locked(w);
+    pthread_mutex_unlock(&w->lock);
+    return rc;
+}
+
+// Background flusher: bounds how long a record may sit in the buffer
+// when no further appends arrive (e.g. an idle REPL).
+static void *log_writer_flusher(void *arg) {
+    LogWriter *w = arg;
+    pthread_mutex_lock(&w->lock);
+    while (!w->closing) {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        uint64_t ns = (uint64_t)until.tv_nsec + (uint64_t)w->policy.flush_ms * 1000000u;
+        until.tv_sec += (time_t)(ns / 1000000000u);
+        until.tv_nsec = (long)(ns % 1000000000u);
+        pthread_cond_timedwait(&w->wake, &w->lock, &until);
+        if (w->pending) log_writer_flush_locked(w);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+// ---------------------------------------------------
+// Open / Close
+// ---------------------------------------------------
+static int log_writer_open(LogWriter *w, const char *path, LogPolicy policy) {
+    memset(w, 0, sizeof(*w));
+    w->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (w->fd < 0) { perror("open state log"); return 0; }
+    struct stat st;
+    if (fstat(w->fd, &st) == 0) w->size = (uint64_t)st.st_size;
+    w->policy = policy;
+    w->cap = LOG_BUF_INITIAL;
+    w->buf = malloc(w->cap);
+    if (!w->buf) { close(w->fd); w->fd = -1; return 0; }
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->wake, NULL);
+    if (policy.flush_ms &&
+        pthread_create(&w->flusher, NULL, log_writer_flusher, w) == 0)
+        w->flusher_running = 1;
+    return 1;
+}
+
+static void log_writer_close(LogWriter *w) {
+    if (!w->buf) return;
+    pthread_mutex_lock(&w->lock);
+    w->closing = 1;
+    pthread_cond_signal(&w->wake);
+    pthread_mutex_unlock(&w->lock);
+    if (w->flusher_running) pthread_join(w->flusher, NULL);
+    log_writer_flush(w);
+    close(w->fd);
+    free(w->buf);
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->wake);
+    w->fd = -1;
+    w->buf = NULL;
+}
+
+// ---------------------------------------------------
+// Append one record
+// ---------------------------------------------------
+// log_writer_append() returns 0 once the record is buffered and stores its
+// file offset in *offset (may be NULL); the offset is final even while the
+// bytes are still buffered. A flush that fails here keeps the bytes for the
+// next one, so the record still counts as written: -1 means it was never taken.
+static void log_writer_commit_locked(LogWriter *w) {
+    if (++w->pending >= w->policy.flush_every && w->policy.flush_every)
+        log_writer_flush_locked(w);
+}
+
+static int log_writer_reserve_locked(LogWriter *w, size_t n) {
+    if (w->cap - w->len > n) return 1;
+    size_t cap = w->cap * 2;
+    while (cap - w->len <= n) cap *= 2;
+    char *nb = realloc(w->buf, cap);
+    if (!nb) return 0;
+    w->buf = nb;
+    w->cap = cap;
+    return 1;
+}
+
+static int log_writer_append(LogWriter *w, const void *rec, size_t n, uint64_t *offset) {
+    if (!w->buf) return -1;
+    pthread_mutex_lock(&w->lock);
+    if (!log_writer_reserve_locked(w, n)) { pthread_mutex_unlock(&w->lock); return -1; }
+    if (offset) *offset = w->size;
+    memcpy(w->buf + w->len, rec, n);
+    w->len += n;
+    w->size += n;
+    log_writer_commit_locked(w);
+    pthread_mutex_unlock(&w->lock);
+    return 0;
+}
+
+#endif // FORENZO_LOG_H
@@ -0,0 +1,150 @@
+// forenzo_lz.h — byte-oriented LZ77 block codec for archive columns
+// A compressed block is a run of sequences:
+//   token   u8: literal count (high nibble), match length - 4 (low nibble);
+//           15 in a nibble continues in extra bytes, each 255 meaning "more"
+//   literal extra bytes, the literals
+//   offset  u16 LE, 1..65535 bytes back       (absent in the last sequence)
+//   match   extra bytes                       (absent in the last sequence)
+// The last sequence carries only literals. There is no entropy stage
+// (LZ4's trade: speed over ratio); a short hash chain per position finds
+// the repeats that dominate archive columns.
+
+#ifndef FORENZO_LZ_H
+#define FORENZO_LZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 14
+#define LZ_WINDOW    65535
+#define LZ_TAIL      12     // the final bytes are always literals
+#define LZ_PROBES    16     // chain entries tried per position
+
+// Worst-case compressed size of n bytes.
+static inline size_t lz_bound(size_t n) {
+    return n + n / 255 + 16;
+}
+
+static inline uint32_t lz_read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint32_t lz_hash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static inline unsigned char *lz_put_len(unsigned char *o, size_t n) {
+    while (n >= 255) { *o++ = 255; n -= 255; }
+    *o++ = (unsigned char)n;
+    return o;
+}
+
+static inline unsigned char *lz_literals(unsigned char *o, const unsigned char *lit, size_t n, unsigned match) {
+    *o++ = (unsigned char)((n >= 15 ? 15 : n) << 4 | match);
+    if (n >= 15) o = lz_put_len(o, n - 15);
+    memcpy(o, lit, n);
+    return o + n;
+}
+
+// ---------------------------------------------------
+// Compress
+// ---------------------------------------------------
+// Positions with the same 4-byte hash are chained (head -> newest, then
+// back through prev[]), and up to LZ_PROBES of them are tried for the
+// longest match inside the window.
+typedef struct {
+    uint32_t head[1 << LZ_HASH_BITS];   // position + 1, 0 = none
+    uint16_t prev[LZ_WINDOW + 1];       // distance to the previous position
+} LzMatcher;
+
+static inline size_t lz_match_len(const unsigned char *a, const unsigned char *b, const unsigned char *end) {
+    const unsigned char *start = a;
+    while (a < end && *a == *b) { a++; b++; }
+    return (size_t)(a - start);
+}
+
+static inline void lz_insert(LzMatcher *m, const unsigned char *src, const unsigned char *p) {
+    uint32_t pos = (uint32_t)(p - src), h = lz_hash(lz_read32(p));
+    uint32_t prior = m->head[h];
+    m->prev[pos & LZ_WINDOW] = prior && pos - (prior - 1) <= LZ_WINDOW ? (uint16_t)(pos - (prior - 1)) : 0;
+    m->head[h] = pos + 1;
+}
+
+// dst must hold lz_bound(n) bytes; m is scratch (about 192 KiB, so
+// callers keep one around). Returns the compressed size.
+static inline size_t lz_compress(LzMatcher *m, const unsigned char *src, size_t n, unsigned char *dst) {
+    memset(m->head, 0, sizeof(m->head));
+    const unsigned char *ip = src, *anchor = src, *end = src + n;
+    const unsigned char *limit = n > LZ_TAIL ? end - LZ_TAIL : src, *match_end = end - LZ_TAIL / 2;
+    unsigned char *o = dst;
+    while (ip < limit) {
+        uint32_t h = lz_hash(lz_read32(ip)), cand = m->head[h];
+        size_t best = 0, off = 0;
+        const unsigned char *ref = cand ? src + cand - 1 : NULL;
+        for (int probe = 0; ref && probe < LZ_PROBES && ip - ref <= LZ_WINDOW; probe++) {
+            if (lz_read32(ref) == lz_read32(ip)) {
+                size_t len = LZ_MIN_MATCH + lz_match_len(ip + LZ_MIN_MATCH, ref + LZ_MIN_MATCH, match_end);
+                if (len > best) { best = len; off = (size_t)(ip - ref); }
+            }
+            uint16_t d = m->prev[(size_t)(ref - src) & LZ_WINDOW];
+            ref = d ? ref - d : NULL;
+        }
+        lz_insert(m, src, ip);
+        if (!best) { ip++; continue; }
+        size_t mlen = best - LZ_MIN_MATCH;
+        o = lz_literals(o, anchor, (size_t)(ip - anchor), mlen >= 15 ? 15 : (unsigned)mlen);
+        *o++ = (unsigned char)off;
+        *o++ = (unsigned char)(off >> 8);
+        if (mlen >= 15) o = lz_put_len(o, mlen - 15);
+        // index the matched bytes too, so later repeats can find them
+        for (const unsigned char *p = ip + 1; p < ip + best && p < limit; p++) lz_insert(m, src, p);
+        ip = anchor = ip + best;
+    }
+    o = lz_literals(o, anchor, (size_t)(end - anchor), 0);
+    return (size_t)(o - dst);
+}
+
+// ---------------------------------------------------
+// Decompress
+// ---------------------------------------------------
+static inline int lz_get_len(const unsigned char **ip, const unsigned char *end, size_t *n) {
+    unsigned char b;
+    do {
+        if (*ip == end) return 0;
+        b = *(*ip)++;
+        *n += b;
+    } while (b == 255);
+    return 1;
+}
+
+// Returns 1 when src decodes to exactly out_n bytes in dst; never reads
+// or writes out of bounds, whatever src holds.
+static inline int lz_decompress(const unsigned char *src, size_t n, unsigned char *dst, size_t out_n) {
+    const unsigned char *ip = src, *end = src + n;
+    unsigned char *o = dst, *oend = dst + out_n;
+    while (ip < end) {
+        unsigned token = *ip++;
+        size_t lit = token >> 4, mlen = token & 15;
+        if (lit == 15 && !lz_get_len(&ip, end, &lit)) return 0;
+        if (lit > (size_t)(end - ip) || lit > (size_t)(oend - o)) return 0;
+        memcpy(o, ip, lit);
+        o += lit;
+        ip += lit;
+        if (ip == end) break;
+        if (end - ip < 2) return 0;
+        size_t off = (size_t)ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+        if (mlen == 15 && !lz_get_len(&ip, end, &mlen)) return 0;
+        mlen += LZ_MIN_MATCH;
+        if (off == 0 || off > (size_t)(o - dst) || mlen > (size_t)(oend - o)) return 0;
+        const unsigned char *r = o - off;
+        while (mlen--) *o++ = *r++;         // may overlap: runs copy forward
+    }
+    return o == oend;
+}
+
+#endif // FORENZO_LZ_H
@@ -0,0 +1,361 @@
+// forenzo_metrics.h — per-command counters and latency histograms
+// Each Metric counts events and files their latencies into log-bucketed
+// histograms in the HDR style: 16 linear sub-buckets per power of two, so
+// any recorded value is within 1/16 (~6%) of its bucket. Each recording
+// thread gets its own shard of counters, which only it writes (plain
+// loads and stores, no lock-prefixed adds); readers sum the shards, so
+// any thread may record while another prints or dumps.
+//
+//   uint64_t t0 = metric_now();
+//   ...
+//   metric_since(&metrics[M_APPEND], t0);
+//
+// metrics_dumper_start() queues a JSON line of every metric on the
+// audit log (forenzo_audit.h) every N seconds, alongside its other events.
+
+#ifndef FORENZO_METRICS_H
+#define FORENZO_METRICS_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "forenzo_audit.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#endif
+
+#define METRIC_SUB_BITS 4
+#define METRIC_SUB      (1u << METRIC_SUB_BITS)
+#define METRIC_MAX_EXP  47          // 2^47 ticks: hours; longer lands in the last bucket
+#define METRIC_BUCKETS  ((METRIC_MAX_EXP - METRIC_SUB_BITS + 2) * METRIC_SUB)
+#define METRIC_SHARDS   8           // the first 7 recording threads own one; later ones share the last
+
+typedef struct {
+    _Atomic uint64_t total;         // ticks; the event count is the sum of the buckets
+    _Atomic uint64_t max;
+    _Atomic uint64_t buckets[METRIC_BUCKETS];
+} MetricShard;
+
+typedef struct {
+    const char *name;
+    _Atomic(MetricShard *) shards[METRIC_SHARDS];   // allocated on a thread's first event
+    _Atomic(MetricShard *) base;    // sums at the last reset, subtracted when read
+} Metric;
+
+// ---------------------------------------------------
+// Clock
+// ---------------------------------------------------
+// Events are timed in ticks: the TSC where it runs at a constant rate
+// (a few ns to read, against ~20 ns for clock_gettime), otherwise
+// CLOCK_MONOTONIC nanoseconds. Histograms hold ticks and become ns only
+// when read, calibrated against the time since start-up.
+static inline uint64_t metric_mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static int metric_tsc = -1;         // invariant TSC available, -1 = not checked yet
+static uint64_t metric_ref_ticks, metric_ref_ns;
+
+__attribute__((constructor)) static void metric_clock_start(void) {
+    unsigned a, b, c, d;
+    metric_tsc = __get_cpuid(0x80000007, &a, &b, &c, &d) && (d & (1u << 8));
+    metric_ref_ns = metric_mono_ns();
+    metric_ref_ticks = __rdtsc();
+}
+
+static inline uint64_t metric_now(void) {
+    return metric_tsc > 0 ? __rdtsc() : metric_mono_ns();
+}
+
+static inline double metric_ticks_per_ns(void) {
+    if (metric_tsc <= 0) return 1.0;
+    uint64_t ns = metric_mono_ns();
+    if (ns - metric_ref_ns < 10000000) {     // too soon after start-up to tell
+        struct timespec wait = { 0, (long)(10000000 - (ns - metric_ref_ns)) };
+        nanosleep(&wait, NULL);
+        ns = metric_mono_ns();
+    }
+    return (double)(__rdtsc() - metric_ref_ticks) / (double)(ns - metric_ref_ns);
+}
+#else
+static inline uint64_t metric_now(void) { return metric_mono_ns(); }
+static inline double metric_ticks_per_ns(void) { return 1.0; }
+#endif
+
+// ---------------------------------------------------
+// Recording
+// ---------------------------------------------------
+static inline unsigned metric_bucket(uint64_t ticks) {
+    if (ticks < METRIC_SUB) return (unsigned)ticks;
+    unsigned e = 63 - (unsigned)__builtin_clzll(ticks);
+    if (e > METRIC_MAX_EXP) return METRIC_BUCKETS - 1;
+    return (e - METRIC_SUB_BITS + 1) * METRIC_SUB + (unsigned)((ticks >> (e - METRIC_SUB_BITS)) & (METRIC_SUB - 1));
+}
+
+// Largest value that lands in bucket b.
+static inline uint64_t metric_bucket_high(unsigned b) {
+    if (b < METRIC_SUB) return b;
+    unsigned e = b / METRIC_SUB + METRIC_SUB_BITS - 1;
+    uint64_t low = (uint64_t)(METRIC_SUB + b % METRIC_SUB) << (e - METRIC_SUB_BITS);
+    return low + ((uint64_t)1 << (e - METRIC_SUB_BITS)) - 1;
+}
+
+static _Atomic unsigned metric_threads;
+static _Thread_local int metric_slot = -1;
+
+// *at, allocated (zeroed) if still NULL; NULL when out of memory.
+static inline MetricShard *metric_shard_get(_Atomic(MetricShard *) *at) {
+    MetricShard *s = atomic_load_explicit(at, memory_order_acquire), *none = NULL;
+    if (s) return s;
+    if (!(s = calloc(1, sizeof(MetricShard)))) return NULL;
+    if (atomic_compare_exchange_strong_explicit(at, &none, s, memory_order_acq_rel, memory_order_acquire)) return s;
+    free(s);
+    return none;
+}
+
+static inline void metric_record(Metric *m, uint64_t ticks) {
+    if (metric_slot < 0) {
+        unsigned t = atomic_fetch_add_explicit(&metric_threads, 1, memory_order_relaxed);
+        metric_slot = t < METRIC_SHARDS - 1 ? (int)t : METRIC_SHARDS - 1;
+    }
+    MetricShard *s = metric_shard_get(&m->shards[metric_slot]);
+    if (!s) return;
+    _Atomic uint64_t *b = &s->buckets[metric_bucket(ticks)];
+    uint64_t max = atomic_load_explicit(&s->max, memory_order_relaxed);
+    if (metric_slot < METRIC_SHARDS - 1) {     // sole writer
+        atomic_store_explicit(&s->total, atomic_load_explicit(&s->total, memory_order_relaxed) + ticks,
+                              memory_order_relaxed);
+        atomic_store_explicit(b, atomic_load_explicit(b, memory_order_relaxed) + 1, memory_order_relaxed);
+        if (ticks > max) atomic_store_explicit(&s->max, ticks, memory_order_relaxed);
+        return;
+    }
+    atomic_fetch_add_explicit(&s->total, ticks, memory_order_relaxed);
+    atomic_fetch_add_explicit(b, 1, memory_order_relaxed);
+    while (ticks > max && !atomic_compare_exchange_weak_explicit(&s->max, &max, ticks,
+                                                                 memory_order_relaxed, memory_order_relaxed));
+}
+
+static inline void metric_since(Metric *m, uint64_t t0) {
+    metric_record(m, metric_now() - t0);
+}
+
+// ---------------------------------------------------
+// Reading
+// ---------------------------------------------------
+typedef struct {
+    uint64_t count, mean, p50, p90, p99, max;   // latencies in ns
+} MetricSummary;
+
+// Sum over the shards of one counter (offset into MetricShard), less its
+// value at the last reset.
+static inline uint64_t metric_sum(Metric *m, size_t off) {
+    uint64_t n = 0;
+    for (unsigned i = 0; i < METRIC_SHARDS; i++) {
+        MetricShard *s = atomic_load_explicit(&m->shards[i], memory_order_acquire);
+        if (s) n += atomic_load_explicit((_Atomic uint64_t *)((char *)s + off), memory_order_relaxed);
+    }
+    MetricShard *base = atomic_load_explicit(&m->base, memory_order_acquire);
+    return base ? n - atomic_load_explicit((_Atomic uint64_t *)((char *)base + off), memory_order_relaxed) : n;
+}
+
+#define METRIC_BUCKET_AT(b) (offsetof(MetricShard, buckets) + (b) * sizeof(uint64_t))
+
+// Percentiles come from the buckets, so they are upper bounds within
+// one sub-bucket; counts read mid-update may be off by an event.
+static inline MetricSummary metric_summary(Metric *m, double ticks_per_ns) {
+    MetricSummary s = {0};
+    static const double q[3] = { 0.50, 0.90, 0.99 };
+    uint64_t *out[3] = { &s.p50, &s.p90, &s.p99 };
+    uint64_t n = 0, max = 0;
+    for (unsigned b = 0; b < METRIC_BUCKETS; b++) n += metric_sum(m, METRIC_BUCKET_AT(b));
+    s.count = n;
+    for (unsigned i = 0; i < METRIC_SHARDS; i++) {
+        MetricShard *sh = atomic_load_explicit(&m->shards[i], memory_order_acquire);
+        uint64_t v = sh ? atomic_load_explicit(&sh->max, memory_order_relaxed) : 0;
+        if (v > max) max = v;
+    }
+    s.max = (uint64_t)((double)max / ticks_per_ns);
+    if (n == 0) return s;
+    s.mean = (uint64_t)((double)metric_sum(m, offsetof(MetricShard, total)) / (double)n / ticks_per_ns);
+    uint64_t seen = 0;
+    int k = 0;
+    for (unsigned b = 0; b < METRIC_BUCKETS && k < 3; b++) {
+        seen += metric_sum(m, METRIC_BUCKET_AT(b));
+        while (k < 3 && seen > 0 && (double)seen >= q[k] * (double)n) {
+            uint64_t high = metric_bucket_high(b);
+            *out[k++] = (uint64_t)((double)(high < max ? high : max) / ticks_per_ns);
+        }
+    }
+    return s;
+}
+
+// Shards belong to their recording threads, so a reset moves the
+// baseline instead of clearing them; only the maxima are cleared.
+static inline void metric_reset(Metric *m) {
+    MetricShard *base = metric_shard_get(&m->base);
+    if (!base) return;
+    uint64_t total = metric_sum(m, offsetof(MetricShard, total));
+    atomic_fetch_add_explicit(&base->total, total, memory_order_relaxed);
+    for (unsigned b = 0; b < METRIC_BUCKETS; b++)
+        atomic_fetch_add_explicit(&base->buckets[b], metric_sum(m, METRIC_BUCKET_AT(b)), memory_order_relaxed);
+    for (unsigned i = 0; i < METRIC_SHARDS; i++) {
+        MetricShard *s = atomic_load_explicit(&m->shards[i], memory_order_acquire);
+        if (s) atomic_store_explicit(&s->max, 0, memory_order_relaxed);
+    }
+}
+
+// 850ns, 12.4us, 3.07ms, 1.50s
+static inline const char *metric_fmt(char *buf, size_t n, uint64_t ns) {
+    if (ns < 1000) snprintf(buf, n, "%lluns", (unsigned long long)ns);
+    else if (ns < 1000000) snprintf(buf, n, "%.1fus", ns / 1e3);
+    else if (ns < 1000000000) snprintf(buf, n, "%.2fms", ns / 1e6);
+    else snprintf(buf, n, "%.2fs", ns / 1e9);
+    return buf;
+}
+
+// The stats command: one row per metric that has seen events.
+static inline void metrics_print(FILE *out, Metric *ms, size_t n) {
+    char a[16], b[16], c[16], d[16], e[16];
+    double tpn = metric_ticks_per_ns();
+    int any = 0;
+    for (size_t i = 0; i < n; i++) {
+        MetricSummary s = metric_summary(&ms[i], tpn);
+        if (s.count == 0) continue;
+        if (!any++) fprintf(out, "  %-20s %10s %9s %9s %9s %9s %9s\n", "", "count", "mean", "p50", "p90", "p99", "max");
+        fprintf(out, "  %-20s %10llu %9s %9s %9s %9s %9s\n", ms[i].name, (unsigned long long)s.count,
+                metric_fmt(a, sizeof(a), s.mean), metric_fmt(b, sizeof(b), s.p50),
+                metric_fmt(c, sizeof(c), s.p90), metric_fmt(d, sizeof(d), s.p99),
+                metric_fmt(e, sizeof(e), s.max));
+    }
+    if (!any) fprintf(out, "  Nothing recorded yet.\n");
+}
+
+// {"ts":...,"event":"stats","metrics":{"append_entry":{"count":..},...}}
+// and a newline; returns its length, or 0 when it does not fit in cap.
+static inline size_t metrics_json(char *buf, size_t cap, const char *ts, Metric *ms, size_t n) {
+    size_t len = 0;
+    double tpn = metric_ticks_per_ns();
+#define METRICS_PUT(...) do { \
+        int w = snprintf(buf + len, cap - len, __VA_ARGS__); \
+        if (w < 0 || (size_t)w >= cap - len) goto full; \
+        len += (size_t)w; \
+    } while (0)
+    METRICS_PUT("{\"ts\":\"%s\",\"event\":\"stats\",\"metrics\":{", ts);
+    for (size_t i = 0; i < n; i++) {
+        MetricSummary s = metric_summary(&ms[i], tpn);
+        METRICS_PUT("%s\"%s\":{\"count\":%llu,\"mean_ns\":%llu,\"p50_ns\":%llu,\"p90_ns\":%llu,"
+                    "\"p99_ns\":%llu,\"max_ns\":%llu}",
+                    i ? "," : "", ms[i].name, (unsigned long long)s.count, (unsigned long long)s.mean,
+                    (unsigned long long)s.p50, (unsigned long long)s.p90,
+                    (unsigned long long)s.p99, (unsigned long long)s.max);
+    }
+    METRICS_PUT("}}\n");
+    return len;
+full:
+    return 0;
+#undef METRICS_PUT
+}
+
+// ---------------------------------------------------
+// Periodic dumps to the audit log
+// ---------------------------------------------------
+static inline size_t metrics_json_now(char *buf, size_t cap, Metric *ms, size_t n) {
+    char ts[64];
+    audit_timestamp(ts, sizeof(ts));
+    return metrics_json(buf, cap, ts, ms, n);
+}
+
+static inline int metrics_dump(AuditLog *log, Metric *ms, size_t n) {
+    char line[8192];
+    size_t len = metrics_json_now(line, sizeof(line), ms, n);
+    return len && audit_log(log, line, len);
+}
+
+// stats         -- table of every metric
+// stats|json    -- the same as one JSON line
+// stats|dump    -- append that line to the activity log now
+// stats|reset   -- start counting afresh
+static inline void metrics_command(FILE *out, const char *arg, Metric *ms, size_t n, AuditLog *log) {
+    if (!arg || !*arg) { metrics_print(out, ms, n); return; }
+    if (strcmp(arg, "json") == 0) {
+        char line[8192];
+        size_t len = metrics_json_now(line, sizeof(line), ms, n);
+        fwrite(line, 1, len, out);
+    } else if (strcmp(arg, "dump") == 0) {
+        if (metrics_dump(log, ms, n)) fprintf(out, "Stats queued for %s.\n", log->path);
+    } else if (strcmp(arg, "reset") == 0) {
+        for (size_t i = 0; i < n; i++) metric_reset(&ms[i]);
+        fprintf(out, "Stats reset.\n");
+    } else {
+        fprintf(out, "Usage: stats[|json|dump|reset]\n");
+    }
+}
+
+typedef struct {
+    Metric *metrics;
+    size_t n;
+    AuditLog *log;
+    unsigned every_s;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t thread;
+    int running, closing;
+} MetricsDumper;
+
+static inline void *metrics_dumper_main(void *arg) {
+    MetricsDumper *d = arg;
+    pthread_mutex_lock(&d->lock);
+    while (!d->closing) {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += d->every_s;
+        while (!d->closing && pthread_cond_timedwait(&d->wake, &d->lock, &until) == 0);
+        if (d->closing) break;
+        pthread_mutex_unlock(&d->lock);
+        metrics_dump(d->log, d->metrics, d->n);
+        pthread_mutex_lock(&d->lock);
+    }
+    pthread_mutex_unlock(&d->lock);
+    return NULL;
+}
+
+static inline int metrics_dumper_start(MetricsDumper *d, AuditLog *log, unsigned every_s,
+                                       Metric *ms, size_t n) {
+    memset(d, 0, sizeof(*d));
+    if (every_s == 0) return 1;
+    d->metrics = ms;
+    d->n = n;
+    d->every_s = every_s;
+    d->log = log;
+    pthread_mutex_init(&d->lock, NULL);
+    pthread_cond_init(&d->wake, NULL);
+    d->running = pthread_create(&d->thread, NULL, metrics_dumper_main, d) == 0;
+    return d->running;
+}
+
+// Stops the thread and writes a last line covering the final interval.
+static inline void metrics_dumper_stop(MetricsDumper *d) {
+    if (!d->running) return;
+    pthread_mutex_lock(&d->lock);
+    d->closing = 1;
+    pthread_cond_signal(&d->wake);
+    pthread_mutex_unlock(&d->lock);
+    pthread_join(d->thread, NULL);
+    d->running = 0;
+    metrics_dump(d->log, d->metrics, d->n);
+    pthread_mutex_destroy(&d->lock);
+    pthread_cond_destroy(&d->wake);
+}
+
+#endif // FORENZO_METRICS_H
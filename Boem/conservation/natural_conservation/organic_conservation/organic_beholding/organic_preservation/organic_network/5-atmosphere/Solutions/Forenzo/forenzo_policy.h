@@ -0,0 +1,1113 @@
+// forenzo_policy.h — in-process policy engine for forenzo_config.json
+// The config is parsed once into an immutable Policy; checks read it
+// through one atomic pointer, and a watcher thread swaps in a fresh one
+// when the file changes (inotify on Linux, a once-a-second stat
+// elsewhere). A config that does not parse is reported and the running
+// policy stays.
+//
+// Guarded actions:
+//   tx <microalgo>:<receiver>
+//                    within the rolling-day spend limit; over
+//                    require_human_for.tx_amount_microalgo_gt it needs consent
+//   publish <what>   needs consent when require_human_for.publish_to_internet
+//   paid_api <what>  needs consent when require_human_for.call_paid_api
+//   fetch <url>      only hosts in allowed_domains (or their subdomains)
+// under autonomy_level act-with-approval; "observe" denies them all and
+// "autonomous" asks for no consent (the spend limit and domains still hold).
+// With no config file there is no policy, and everything is denied.
+//
+// Consent is a token "<action>.<issued unix time>.<nonce>.<hex HMAC>",
+// the HMAC-SHA256 being over "<action>.<issued>.<nonce>.<arg>" with the
+// key in consent_key_file, so it covers one amount and receiver (or one
+// <what>). It is valid for consent_token_ttl_seconds and only once: a
+// token's nonce is recorded in the nonce file when it is accepted.
+// Verified tokens are cached until they expire, and the used nonces are
+// kept in memory, catching up on the file's new lines at each use; lines
+// for tokens that can no longer verify are compacted out of the file.
+//
+// An allowed tx is only held against the day's limit; it is spent when
+// the payer reports the payment went out (policy_spent), and a hold
+// nobody confirms lapses after POLICY_HOLD_SECONDS. Spend is kept in 24
+// hourly buckets (persisted after each spend), so a check costs the same
+// however many payments the day held.
+
+#ifndef FORENZO_POLICY_H
+#define FORENZO_POLICY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "forenzo_endian.h"
+#include "forenzo_crc32.h"
+#include "forenzo_sha256.h"
+#include "forenzo_intern.h"     // the domain set
+#include "forenzo_audit.h"
+#include "forenzo_json.h"
+
+#define POLICY_KEY_MAX      256
+#define POLICY_TOKEN_MAX    160
+#define POLICY_NONCE_HEX    16          // 64 random bits per token
+#define POLICY_ARG_MAX      256         // arguments a token can cover
+#define POLICY_CACHE_SLOTS  256         // verified consent tokens (direct-mapped)
+#define POLICY_NONCES_MIN   256         // nonce file lines before a compaction
+#define POLICY_HOLDS        64          // allowed payments not yet confirmed
+#define POLICY_HOLD_SECONDS 600
+#define POLICY_SPEND_HOURS  24
+#define POLICY_POLL_MS      1000
+#define POLICY_DEFAULT_KEY  "forenzo_consent.key"
+
+typedef enum { POLICY_OBSERVE, POLICY_ACT_WITH_APPROVAL, POLICY_AUTONOMOUS } PolicyAutonomy;
+typedef enum { POLICY_TX, POLICY_PUBLISH, POLICY_PAID_API, POLICY_FETCH, POLICY_NACTIONS } PolicyAction;
+typedef enum { POLICY_ALLOW, POLICY_CONSENT, POLICY_DENY } PolicyVerdict;
+
+static const char *const policy_action_names[POLICY_NACTIONS] = { "tx", "publish", "paid_api", "fetch" };
+static const char *const policy_verdict_names[] = { "allow", "consent", "deny" };
+
+// A compiled config. Never changed once published, so checks need no lock.
+typedef struct Policy {
+    uint64_t generation;
+    PolicyAutonomy autonomy;
+    int64_t daily_spend_limit;          // microalgo
+    int64_t human_tx_over;              // microalgo; consent above this
+    int human_publish, human_paid_api;
+    InternTable domains;                // lower case, no leading dot
+    uint32_t ttl;                       // consent token lifetime, seconds
+    unsigned char key[POLICY_KEY_MAX];
+    size_t key_n;                       // 0: no key, so no token is valid
+    struct Policy *retired;             // older policies (see policy_close)
+} Policy;
+
+typedef struct {
+    uint64_t hash, generation;          // generation: a reload may change the key
+    int64_t issued, expires;
+    PolicyAction action;
+    char nonce[POLICY_NONCE_HEX + 1];
+    char token[POLICY_TOKEN_MAX], arg[POLICY_ARG_MAX];
+} PolicyCacheSlot;
+
+// The nonce file ("<issued> <nonce>" per line, and "<cutoff> pruned" once
+// compacted: tokens issued before cutoff are refused) mirrored in memory.
+typedef struct {
+    uint64_t nonce;
+    int64_t issued;                     // 0: empty
+} PolicyNonce;
+
+typedef struct {
+    PolicyNonce *slots;
+    uint32_t mask, count;
+    uint32_t lines, compact_at;         // lines in the file; compact at this many
+    int fd;                             // -1: not open
+    uint64_t read_to;                   // file bytes already in the set
+    int64_t floor;                      // the last compaction's cutoff
+} PolicyNonces;
+
+typedef struct {
+    int64_t amount, expires;            // expires 0: free slot
+    uint64_t id;                        // which check took it
+    char arg[POLICY_ARG_MAX];           // "<microalgo>:<receiver>"
+} PolicyHold;
+
+typedef struct {
+    int64_t hour[POLICY_SPEND_HOURS];   // unix hour the bucket holds
+    int64_t amount[POLICY_SPEND_HOURS];
+    int64_t total;                      // over the last POLICY_SPEND_HOURS hours
+} PolicySpend;
+
+typedef struct {
+    _Atomic(Policy *) current;
+    char path[1024], spend_path[1024], nonce_path[1024];
+    AuditLog *audit;                    // decisions and reloads (may be NULL)
+    pthread_mutex_t lock;               // spend, holds, cache and nonces
+    PolicySpend spend;
+    PolicyCacheSlot cache[POLICY_CACHE_SLOTS];
+    PolicyNonces nonces;
+    PolicyHold holds[POLICY_HOLDS];
+    int64_t held;                       // sum of the live holds
+    uint64_t hold_ids;
+    uint64_t generations;
+    int watch_fd, stop[2];
+    pthread_t watcher;
+    int watching;
+    struct stat seen;                   // the file as last loaded
+} PolicyEngine;
+
+// ---------------------------------------------------
+// Config parsing
+// ---------------------------------------------------
+// Just enough JSON for a config: objects, arrays, strings, integers,
+// booleans and null. Unknown top-level keys are skipped; an unknown rule
+// under require_human_for is an error rather than silently unenforced.
+typedef struct {
+    const char *p, *end;
+    char err[160];
+} PolicyParser;
+
+static inline int pp_fail(PolicyParser *pp, const char *what) {
+    if (!pp->err[0]) snprintf(pp->err, sizeof(pp->err), "%s", what);
+    return 0;
+}
+
+static inline void pp_ws(PolicyParser *pp) {
+    while (pp->p < pp->end && (*pp->p == ' ' || *pp->p == '\t' || *pp->p == '\n' || *pp->p == '\r')) pp->p++;
+}
+
+static inline int pp_eat(PolicyParser *pp, char c) {
+    pp_ws(pp);
+    if (pp->p < pp->end && *pp->p == c) { pp->p++; return 1; }
+    return 0;
+}
+
+static inline int pp_hex4(PolicyParser *pp, uint32_t *v) {
+    if (pp->end - pp->p < 4) return 0;
+    *v = 0;
+    for (int i = 0; i < 4; i++) {
+        int c = pp->p[i], d = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                              c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (d < 0) return 0;
+        *v = *v << 4 | (uint32_t)d;
+    }
+    pp->p += 4;
+    return 1;
+}
+
+// A string into out (NUL-terminated); NULL out just skips it.
+static inline int pp_string(PolicyParser *pp, char *out, size_t cap) {
+    if (!pp_eat(pp, '"')) return pp_fail(pp, "expected a string");
+    size_t n = 0;
+    while (pp->p < pp->end && *pp->p != '"') {
+        unsigned char c = (unsigned char)*pp->p++;
+        char enc[4];
+        size_t len = 1;
+        enc[0] = (char)c;
+        if (c < 0x20) return pp_fail(pp, "control character in a string");
+        if (c == '\\') {
+            if (pp->p == pp->end) break;
+            switch (*pp->p++) {
+                case '"': enc[0] = '"'; break;
+                case '\\': enc[0] = '\\'; break;
+                case '/': enc[0] = '/'; break;
+                case 'b': enc[0] = '\b'; break;
+                case 'f': enc[0] = '\f'; break;
+                case 'n': enc[0] = '\n'; break;
+                case 'r': enc[0] = '\r'; break;
+                case 't': enc[0] = '\t'; break;
+                case 'u': {
+                    uint32_t cp, lo;
+                    if (!pp_hex4(pp, &cp)) return pp_fail(pp, "bad \\u escape");
+                    if (cp >= 0xD800 && cp <= 0xDBFF && pp->end - pp->p >= 6 && pp->p[0] == '\\' && pp->p[1] == 'u') {
+                        pp->p += 2;
+                        if (!pp_hex4(pp, &lo) || lo < 0xDC00 || lo > 0xDFFF) return pp_fail(pp, "bad surrogate pair");
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    } else if (cp >= 0xD800 && cp <= 0xDFFF) {
+                        return pp_fail(pp, "lone surrogate");
+                    }
+                    if (cp == 0) return pp_fail(pp, "NUL in a string");
+                    if (cp < 0x80) enc[0] = (char)cp;
+                    else if (cp < 0x800) { enc[0] = (char)(0xC0 | cp >> 6); enc[1] = (char)(0x80 | (cp & 0x3F)); len = 2; }
+                    else if (cp < 0x10000) {
+                        enc[0] = (char)(0xE0 | cp >> 12); enc[1] = (char)(0x80 | (cp >> 6 & 0x3F));
+                        enc[2] = (char)(0x80 | (cp & 0x3F)); len = 3;
+                    } else {
+                        enc[0] = (char)(0xF0 | cp >> 18); enc[1] = (char)(0x80 | (cp >> 12 & 0x3F));
+                        enc[2] = (char)(0x80 | (cp >> 6 & 0x3F)); enc[3] = (char)(0x80 | (cp & 0x3F)); len = 4;
+                    }
+                    break;
+                }
+                default: return pp_fail(pp, "bad escape");
+            }
+        }
+        if (out) {
+            if (n + len >= cap) return pp_fail(pp, "string too long");
+            memcpy(out + n, enc, len);
+        }
+        n += len;
+    }
+    if (pp->p == pp->end) return pp_fail(pp, "unterminated string");
+    pp->p++;
+    if (out) out[n] = '\0';
+    return 1;
+}
+
+static inline int pp_int(PolicyParser *pp, int64_t *v) {
+    pp_ws(pp);
+    const char *s = pp->p;
+    int neg = s < pp->end && *s == '-';
+    if (neg) s++;
+    if (s == pp->end || !isdigit((unsigned char)*s)) return pp_fail(pp, "expected a number");
+    uint64_t x = 0;
+    for (; s < pp->end && isdigit((unsigned char)*s); s++) {
+        if (x > (uint64_t)INT64_MAX / 10) return pp_fail(pp, "number out of range");
+        x = x * 10 + (uint64_t)(*s - '0');
+    }
+    if (x > (uint64_t)INT64_MAX) return pp_fail(pp, "number out of range");
+    if (s < pp->end && (*s == '.' || *s == 'e' || *s == 'E')) return pp_fail(pp, "expected a whole number");
+    pp->p = s;
+    *v = neg ? -(int64_t)x : (int64_t)x;
+    return 1;
+}
+
+static inline int pp_word(PolicyParser *pp, const char *w) {
+    size_t n = strlen(w);
+    pp_ws(pp);
+    if ((size_t)(pp->end - pp->p) < n || memcmp(pp->p, w, n) != 0) return 0;
+    pp->p += n;
+    return 1;
+}
+
+static inline int pp_bool(PolicyParser *pp, int *v) {
+    if (pp_word(pp, "true")) { *v = 1; return 1; }
+    if (pp_word(pp, "false")) { *v = 0; return 1; }
+    return pp_fail(pp, "expected true or false");
+}
+
+static inline int pp_skip(PolicyParser *pp, int depth) {
+    int64_t n;
+    pp_ws(pp);
+    if (depth > 32) return pp_fail(pp, "nested too deeply");
+    if (pp->p == pp->end) return pp_fail(pp, "unexpected end");
+    char c = *pp->p;
+    if (c == '"') return pp_string(pp, NULL, 0);
+    if (c == '{' || c == '[') {
+        char close = c == '{' ? '}' : ']';
+        pp->p++;
+        if (pp_eat(pp, close)) return 1;
+        do {
+            if (c == '{' && (!pp_string(pp, NULL, 0) || !pp_eat(pp, ':'))) return pp_fail(pp, "expected \"key\":");
+            if (!pp_skip(pp, depth + 1)) return 0;
+        } while (pp_eat(pp, ','));
+        return pp_eat(pp, close) || pp_fail(pp, "expected , or a closing bracket");
+    }
+    if (pp_word(pp, "true") || pp_word(pp, "false") || pp_word(pp, "null")) return 1;
+    if (c == '-' || isdigit((unsigned char)c)) {
+        if (!pp_int(pp, &n)) {          // fractions and exponents are fine where unused
+            pp->err[0] = '\0';
+            while (pp->p < pp->end && strchr("+-.eE0123456789", *pp->p)) pp->p++;
+        }
+        return 1;
+    }
+    return pp_fail(pp, "unexpected character");
+}
+
+// Host part of a URL or bare host, lower-cased, without port or trailing
+// dot. Returns 0 when nothing is left.
+static inline int policy_host(const char *s, char *out, size_t cap) {
+    const char *p = strstr(s, "://");
+    p = p ? p + 3 : s;
+    const char *end = p + strcspn(p, "/?#");
+    const char *at = memchr(p, '@', (size_t)(end - p));
+    if (at) p = at + 1;
+    const char *colon = memchr(p, ':', (size_t)(end - p));
+    if (colon) end = colon;
+    while (p < end && *p == '.') p++;       // ".example.com" as in a cookie domain
+    if (end - p >= 2 && p[0] == '*' && p[1] == '.') p += 2;
+    while (end > p && end[-1] == '.') end--;
+    size_t n = (size_t)(end - p);
+    if (n == 0 || n >= cap) return 0;
+    for (size_t i = 0; i < n; i++) out[i] = (char)tolower((unsigned char)p[i]);
+    out[n] = '\0';
+    return 1;
+}
+
+static inline int policy_parse_rules(PolicyParser *pp, Policy *p) {
+    if (!pp_eat(pp, '{')) return pp_fail(pp, "require_human_for: expected an object");
+    if (pp_eat(pp, '}')) return 1;
+    do {
+        char key[64];
+        if (!pp_string(pp, key, sizeof(key)) || !pp_eat(pp, ':')) return pp_fail(pp, "expected \"key\":");
+        if (strcmp(key, "tx_amount_microalgo_gt") == 0) {
+            if (!pp_int(pp, &p->human_tx_over)) return 0;
+        } else if (strcmp(key, "publish_to_internet") == 0) {
+            if (!pp_bool(pp, &p->human_publish)) return 0;
+        } else if (strcmp(key, "call_paid_api") == 0) {
+            if (!pp_bool(pp, &p->human_paid_api)) return 0;
+        } else {
+            snprintf(pp->err, sizeof(pp->err), "require_human_for: unknown rule \"%.64s\"", key);
+            return 0;
+        }
+    } while (pp_eat(pp, ','));
+    return pp_eat(pp, '}') || pp_fail(pp, "require_human_for: expected , or }");
+}
+
+static inline int policy_parse_domains(PolicyParser *pp, Policy *p) {
+    if (!pp_eat(pp, '[')) return pp_fail(pp, "allowed_domains: expected an array");
+    if (pp_eat(pp, ']')) return 1;
+    do {
+        char raw[256], host[256];
+        if (!pp_string(pp, raw, sizeof(raw))) return 0;
+        if (!policy_host(raw, host, sizeof(host))) {
+            snprintf(pp->err, sizeof(pp->err), "allowed_domains: \"%.64s\" is not a domain", raw);
+            return 0;
+        }
+        if (intern_insert(&p->domains, host, strlen(host), 0) == INTERN_NONE) return pp_fail(pp, "out of memory");
+    } while (pp_eat(pp, ','));
+    return pp_eat(pp, ']') || pp_fail(pp, "allowed_domains: expected , or ]");
+}
+
+static inline void policy_free(Policy *p) {
+    while (p) {
+        Policy *older = p->retired;
+        intern_close(&p->domains);
+        memset(p->key, 0, sizeof(p->key));
+        free(p);
+        p = older;
+    }
+}
+
+// Compiles the config at path; NULL (with err filled in) if it is not valid.
+// Missing settings fail closed: no spending, consent for everything.
+static inline Policy *policy_compile(const char *path, char *err, size_t err_n) {
+    Policy *p = calloc(1, sizeof(Policy));
+    char *text = NULL;
+    FILE *f = fopen(path, "rb");
+    if (!p || !f) {
+        snprintf(err, err_n, "%s", strerror(errno));
+        if (f) fclose(f);
+        free(p);
+        return NULL;
+    }
+    size_t n = 0, cap = 0;
+    for (size_t r;; n += r) {
+        if (n == cap) {
+            char *t = cap < 1 << 20 ? realloc(text, cap = cap ? cap * 2 : 4096) : NULL;
+            if (!t) break;
+            text = t;
+        }
+        if ((r = fread(text + n, 1, cap - n, f)) == 0) break;
+    }
+    fclose(f);
+
+    p->autonomy = POLICY_ACT_WITH_APPROVAL;
+    p->human_tx_over = 0;
+    p->human_publish = p->human_paid_api = 1;
+    p->ttl = 3600;
+    char key_file[256] = POLICY_DEFAULT_KEY, autonomy[64] = "act-with-approval";
+
+    PolicyParser pp = { text, text + n, "" };
+    int ok = text != NULL && pp_eat(&pp, '{');
+    if (!ok) pp_fail(&pp, "expected a JSON object");
+    if (ok && !pp_eat(&pp, '}')) {
+        do {
+            char k[64];
+            int64_t v;
+            ok = pp_string(&pp, k, sizeof(k)) && pp_eat(&pp, ':');
+            if (!ok) { pp_fail(&pp, "expected \"key\":"); break; }
+            if (strcmp(k, "autonomy_level") == 0) ok = pp_string(&pp, autonomy, sizeof(autonomy));
+            else if (strcmp(k, "daily_spend_limit_microalgo") == 0) ok = pp_int(&pp, &p->daily_spend_limit);
+            else if (strcmp(k, "require_human_for") == 0) ok = policy_parse_rules(&pp, p);
+            else if (strcmp(k, "allowed_domains") == 0) ok = policy_parse_domains(&pp, p);
+            else if (strcmp(k, "consent_key_file") == 0) ok = pp_string(&pp, key_file, sizeof(key_file));
+            else if (strcmp(k, "consent_token_ttl_seconds") == 0) {
+                ok = pp_int(&pp, &v);
+                if (ok && (v <= 0 || v > 366 * 86400)) ok = pp_fail(&pp, "consent_token_ttl_seconds out of range");
+                p->ttl = (uint32_t)v;
+            } else ok = pp_skip(&pp, 0);      // audit_log is the log policy_open is given
+        } while (ok && pp_eat(&pp, ','));
+        if (ok && !pp_eat(&pp, '}')) ok = pp_fail(&pp, "expected , or }");
+    }
+    pp_ws(&pp);
+    if (ok && pp.p != pp.end) ok = pp_fail(&pp, "trailing characters");
+    if (ok && p->daily_spend_limit < 0) ok = pp_fail(&pp, "daily_spend_limit_microalgo is negative");
+    if (ok && p->human_tx_over < 0) ok = pp_fail(&pp, "tx_amount_microalgo_gt is negative");
+    if (ok) {
+        if (strcmp(autonomy, "observe") == 0) p->autonomy = POLICY_OBSERVE;
+        else if (strcmp(autonomy, "act-with-approval") == 0) p->autonomy = POLICY_ACT_WITH_APPROVAL;
+        else if (strcmp(autonomy, "autonomous") == 0) p->autonomy = POLICY_AUTONOMOUS;
+        else ok = pp_fail(&pp, "autonomy_level: expected observe, act-with-approval or autonomous");
+    }
+    if (!ok) {
+        size_t line = 1;
+        for (const char *c = text; c && c < pp.p; c++) line += *c == '\n';
+        snprintf(err, err_n, "line %zu: %s", line, pp.err);
+        free(text);
+        policy_free(p);
+        return NULL;
+    }
+    free(text);
+
+    int kfd = open(key_file, O_RDONLY);
+    if (kfd >= 0) {
+        ssize_t r = read(kfd, p->key, sizeof(p->key));
+        p->key_n = r > 0 ? (size_t)r : 0;
+        while (p->key_n && (p->key[p->key_n - 1] == '\n' || p->key[p->key_n - 1] == '\r')) p->key_n--;
+        close(kfd);
+    }
+    return p;
+}
+
+// ---------------------------------------------------
+// Consent tokens
+// ---------------------------------------------------
+// A fresh nonce for a token being minted; 0 without a random source.
+static inline int policy_nonce(char out[POLICY_NONCE_HEX + 1]) {
+    unsigned char r[POLICY_NONCE_HEX / 2];
+    int fd = open("/dev/urandom", O_RDONLY);
+    int ok = fd >= 0 && read(fd, r, sizeof(r)) == (ssize_t)sizeof(r);
+    if (fd >= 0) close(fd);
+    for (size_t i = 0; ok && i < sizeof(r); i++) snprintf(out + 2 * i, 3, "%02x", r[i]);
+    return ok;
+}
+
+static inline int policy_sign(const Policy *p, const char *action, int64_t issued, const char *nonce,
+                              const char *arg, char *out, size_t cap) {
+    char msg[96 + POLICY_ARG_MAX];
+    unsigned char mac[32];
+    char hex[65];
+    if (!p->key_n || strlen(arg) >= POLICY_ARG_MAX) return 0;
+    int n = snprintf(msg, sizeof(msg), "%s.%lld.%s", action, (long long)issued, nonce);
+    int m = snprintf(msg + n, sizeof(msg) - (size_t)n, ".%s", arg);
+    hmac_sha256(p->key, p->key_n, msg, (size_t)(n + m), mac);
+    sha256_hex(mac, hex);
+    return snprintf(out, cap, "%.*s.%s", n, msg, hex) < (int)cap;
+}
+
+// Issue time of a genuine, unexpired token for action on arg (its nonce
+// into nonce); 0 otherwise.
+static inline int64_t policy_verify(const Policy *p, const char *token, PolicyAction action, const char *arg,
+                                    int64_t now, char nonce[POLICY_NONCE_HEX + 1]) {
+    const char *name = policy_action_names[action];
+    size_t nl = strlen(name), len = strlen(token);
+    if (!p->key_n || len >= POLICY_TOKEN_MAX || strncmp(token, name, nl) != 0 || token[nl] != '.') return 0;
+    char *end;
+    long long issued = strtoll(token + nl + 1, &end, 10);
+    if (end == token + nl + 1 || *end != '.' || strlen(end + 1) != POLICY_NONCE_HEX + 1 + 64 ||
+        end[1 + POLICY_NONCE_HEX] != '.')
+        return 0;
+    for (int i = 0; i < POLICY_NONCE_HEX; i++)
+        if (!isxdigit((unsigned char)end[1 + i])) return 0;
+    if (issued <= 0 || issued > now + 300 || issued + (int64_t)p->ttl <= now) return 0;      // 5 min of clock skew
+    memcpy(nonce, end + 1, POLICY_NONCE_HEX);
+    nonce[POLICY_NONCE_HEX] = '\0';
+    char expect[POLICY_TOKEN_MAX];
+    if (!policy_sign(p, name, issued, nonce, arg, expect, sizeof(expect)) || strlen(expect) != len) return 0;
+    unsigned char diff = 0;
+    for (size_t i = 0; i < len; i++) diff |= (unsigned char)(expect[i] ^ token[i]);
+    return diff ? 0 : issued;
+}
+
+// Where nonce v is, or the empty slot it would take.
+static inline PolicyNonce *policy_nonces_slot(PolicyNonces *n, uint64_t v) {
+    uint32_t i = (uint32_t)(v ^ v >> 32) & n->mask;
+    while (n->slots[i].issued && n->slots[i].nonce != v) i = (i + 1) & n->mask;
+    return &n->slots[i];
+}
+
+// Room for one more nonce, so the insert after a write cannot fail.
+static inline int policy_nonces_reserve(PolicyNonces *n) {
+    if (n->slots && (n->count + 1) * 2 <= n->mask + 1) return 1;
+    uint32_t cap = n->slots ? (n->mask + 1) * 2 : 1024;
+    PolicyNonces grown = *n;
+    grown.slots = calloc(cap, sizeof(PolicyNonce));
+    if (!grown.slots) return 0;
+    grown.mask = cap - 1;
+    for (uint32_t i = 0; n->slots && i <= n->mask; i++)
+        if (n->slots[i].issued) *policy_nonces_slot(&grown, n->slots[i].nonce) = n->slots[i];
+    free(n->slots);
+    *n = grown;
+    return 1;
+}
+
+static inline void policy_nonces_add(PolicyNonces *n, uint64_t v, int64_t issued) {
+    PolicyNonce *s = policy_nonces_slot(n, v);
+    if (!s->issued) n->count++;
+    s->nonce = v;
+    s->issued = issued > 0 ? issued : 1;
+}
+
+// 0 when there was no memory for the nonce.
+static inline int policy_nonces_line(PolicyNonces *n, const char *line) {
+    long long v;
+    char word[24];
+    n->lines++;
+    if (sscanf(line, "%lld %23s", &v, word) != 2) return 1;
+    if (strcmp(word, "pruned") == 0) {
+        if (v > n->floor) n->floor = v;
+    } else if (strlen(word) == POLICY_NONCE_HEX) {
+        if (!policy_nonces_reserve(n)) return 0;
+        policy_nonces_add(n, strtoull(word, NULL, 16), v);
+    }
+    return 1;
+}
+
+// Takes the exclusive flock on the nonce file and reads the lines other
+// processes added since the last call; the file is read from the start
+// the first time and after another process compacted (replaced) it.
+// Returns 0, with no lock held, on error.
+static inline int policy_nonces_lock(PolicyNonces *n, const char *path) {
+    for (;;) {
+        if (n->fd < 0) {
+            free(n->slots);
+            memset(n, 0, sizeof(*n));
+            n->compact_at = POLICY_NONCES_MIN;
+            n->fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+            if (n->fd < 0) return 0;
+        }
+        if (flock(n->fd, LOCK_EX) != 0) return 0;
+        struct stat a, b;
+        if (fstat(n->fd, &a) == 0 && stat(path, &b) == 0 && a.st_dev == b.st_dev && a.st_ino == b.st_ino) break;
+        close(n->fd);
+        n->fd = -1;
+    }
+    char buf[4096];
+    size_t have = 0;
+    for (;;) {
+        ssize_t got = pread(n->fd, buf + have, sizeof(buf) - 1 - have, (off_t)(n->read_to + have));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break;
+        have += (size_t)got;
+        buf[have] = '\0';
+        char *line = buf, *nl;
+        while ((nl = memchr(line, '\n', have - (size_t)(line - buf)))) {
+            *nl = '\0';
+            if (!policy_nonces_line(n, line)) {
+                close(n->fd);       // read it all again next time
+                n->fd = -1;
+                return 0;
+            }
+            line = nl + 1;
+        }
+        size_t used = (size_t)(line - buf);
+        if (!used && have == sizeof(buf) - 1) used = have;      // not a line of ours: skip it
+        n->read_to += used;
+        memmove(buf, buf + used, have - used);
+        have -= used;
+    }
+    return 1;
+}
+
+// Rewrites the file with the nonces of tokens issued from cutoff on (the
+// rest can no longer verify) and renames it into place. Called under the
+// flock, which the old file takes with it: the caller locks again.
+static inline int policy_nonces_compact(PolicyNonces *n, const char *path, int64_t cutoff) {
+    char tmp[1100], line[64];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) return 0;
+    if (cutoff < n->floor) cutoff = n->floor;
+    fprintf(f, "%lld pruned\n", (long long)cutoff);
+    for (uint32_t i = 0; n->slots && i <= n->mask; i++) {
+        const PolicyNonce *s = &n->slots[i];
+        if (!s->issued || s->issued < cutoff) continue;
+        snprintf(line, sizeof(line), "%lld %016llx\n", (long long)s->issued, (unsigned long long)s->nonce);
+        fputs(line, f);
+    }
+    int ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+    if (fclose(f) != 0) ok = 0;
+    if (ok) ok = rename(tmp, path) == 0;
+    if (!ok) { perror(path); unlink(tmp); return 0; }
+    close(n->fd);
+    n->fd = -1;
+    return 1;
+}
+
+// Records a token's nonce as used: 1 if it was new, 0 if already used
+// (or issued before the file's cutoff), -1 if it could not be recorded.
+// The lock makes a token good once across every process sharing the
+// file. Not fsynced: the use is in the page cache every process reads,
+// and only a machine crash within the token's lifetime could lose it.
+// cutoff is the oldest issue time a token can still verify with.
+static inline int policy_nonce_use(PolicyNonces *n, const char *path, int64_t issued, const char *nonce,
+                                   int64_t cutoff) {
+    if (!policy_nonces_lock(n, path)) return -1;
+    if (n->lines >= n->compact_at) {
+        if (policy_nonces_compact(n, path, cutoff)) {
+            if (!policy_nonces_lock(n, path)) return -1;
+        }
+        n->compact_at = n->count * 2 > POLICY_NONCES_MIN ? n->count * 2 : POLICY_NONCES_MIN;
+    }
+    uint64_t v = strtoull(nonce, NULL, 16);
+    int rc = issued < n->floor || (n->slots && policy_nonces_slot(n, v)->issued) ? 0 : 1;
+    if (rc == 1 && !policy_nonces_reserve(n)) rc = -1;
+    if (rc == 1) {
+        char line[64];
+        int len = snprintf(line, sizeof(line), "%lld %s\n", (long long)issued, nonce);
+        if (write(n->fd, line, (size_t)len) != len) rc = -1;
+        else {
+            policy_nonces_add(n, v, issued);
+            n->read_to += (uint64_t)len;
+            n->lines++;
+        }
+    }
+    flock(n->fd, LOCK_UN);
+    return rc;
+}
+
+static inline void policy_nonces_close(PolicyNonces *n) {
+    if (n->fd >= 0) close(n->fd);
+    free(n->slots);
+    memset(n, 0, sizeof(*n));
+    n->fd = -1;
+}
+
+static inline uint64_t policy_cache_hash(const char *token, const char *arg) {
+    return intern_hash(token, strlen(token)) ^ intern_hash(arg, strlen(arg)) * 0x9E3779B97F4A7C15ull;
+}
+
+// A token verified before, for the same action and arg under the same
+// key: its issue time (and nonce), or 0. Called with the lock held.
+static inline int64_t policy_cached(PolicyEngine *e, const Policy *p, const char *token, PolicyAction action,
+                                    const char *arg, int64_t now, char nonce[POLICY_NONCE_HEX + 1]) {
+    uint64_t h = policy_cache_hash(token, arg);
+    const PolicyCacheSlot *s = &e->cache[h & (POLICY_CACHE_SLOTS - 1)];
+    if (s->hash != h || s->generation != p->generation || s->action != action || now >= s->expires ||
+        strcmp(s->token, token) != 0 || strcmp(s->arg, arg) != 0)
+        return 0;
+    memcpy(nonce, s->nonce, POLICY_NONCE_HEX + 1);
+    return s->issued;
+}
+
+static inline void policy_cache(PolicyEngine *e, const Policy *p, const char *token, PolicyAction action,
+                                const char *arg, int64_t issued, const char *nonce) {
+    if (strlen(token) >= POLICY_TOKEN_MAX || strlen(arg) >= POLICY_ARG_MAX) return;
+    uint64_t h = policy_cache_hash(token, arg);
+    PolicyCacheSlot *s = &e->cache[h & (POLICY_CACHE_SLOTS - 1)];
+    s->hash = h;
+    s->generation = p->generation;
+    s->issued = issued;
+    s->expires = issued + (int64_t)p->ttl;
+    s->action = action;
+    memcpy(s->nonce, nonce, POLICY_NONCE_HEX + 1);
+    memcpy(s->token, token, strlen(token) + 1);
+    memcpy(s->arg, arg, strlen(arg) + 1);
+}
+
+// Consent for action on arg: POLICY_ALLOW when token is genuine and
+// unused (it is then used up), POLICY_CONSENT when not, POLICY_DENY when
+// the use could not be recorded. why is set when a token was refused.
+// A token seen before skips the HMAC until it expires.
+static inline PolicyVerdict policy_consent(PolicyEngine *e, const Policy *p, const char *token, PolicyAction action,
+                                           const char *arg, int64_t now, char *why, size_t why_n) {
+    char nonce[POLICY_NONCE_HEX + 1];
+    if (!token || !*token) return POLICY_CONSENT;
+    if (!arg) arg = "";
+    pthread_mutex_lock(&e->lock);
+    int64_t issued = policy_cached(e, p, token, action, arg, now, nonce);
+    pthread_mutex_unlock(&e->lock);
+    if (!issued) {
+        issued = policy_verify(p, token, action, arg, now, nonce);
+        if (!issued) {
+            snprintf(why, why_n, "consent token is not valid for this %s", policy_action_names[action]);
+            return POLICY_CONSENT;
+        }
+        pthread_mutex_lock(&e->lock);
+        policy_cache(e, p, token, action, arg, issued, nonce);
+        pthread_mutex_unlock(&e->lock);
+    }
+    pthread_mutex_lock(&e->lock);
+    int rc = policy_nonce_use(&e->nonces, e->nonce_path, issued, nonce, now - (int64_t)p->ttl);
+    pthread_mutex_unlock(&e->lock);
+    if (rc == 0) snprintf(why, why_n, "consent token already used");
+    else if (rc < 0) snprintf(why, why_n, "could not record the consent token");
+    return rc > 0 ? POLICY_ALLOW : rc == 0 ? POLICY_CONSENT : POLICY_DENY;
+}
+
+// ---------------------------------------------------
+// Rolling-day spend
+// ---------------------------------------------------
+// Drops buckets older than a day; at most POLICY_SPEND_HOURS steps.
+static inline void policy_spend_advance(PolicySpend *s, int64_t now) {
+    int64_t hour = now / 3600;
+    for (int i = 0; i < POLICY_SPEND_HOURS; i++) {
+        if (s->hour[i] > hour - POLICY_SPEND_HOURS) continue;
+        s->total -= s->amount[i];
+        s->amount[i] = 0;
+        s->hour[i] = 0;
+    }
+}
+
+static inline void policy_spend_add(PolicySpend *s, int64_t now, int64_t amount) {
+    int64_t hour = now / 3600;
+    int i = (int)(hour % POLICY_SPEND_HOURS);
+    if (s->hour[i] != hour) {
+        s->total -= s->amount[i];
+        s->amount[i] = 0;
+        s->hour[i] = hour;
+    }
+    s->amount[i] += amount;
+    s->total += amount;
+}
+
+// forenzo.spend: "FZSP", then (hour, amount) as i64 LE per bucket, crc32.
+#define POLICY_SPEND_SIZE (4 + POLICY_SPEND_HOURS * 16 + 4)
+
+static inline void policy_spend_load(PolicyEngine *e) {
+    unsigned char b[POLICY_SPEND_SIZE];
+    int fd = open(e->spend_path, O_RDONLY);
+    if (fd < 0) return;
+    ssize_t n = read(fd, b, sizeof(b));
+    close(fd);
+    if (n != (ssize_t)sizeof(b) || memcmp(b, "FZSP", 4) != 0 ||
+        get_le32(b + sizeof(b) - 4) != crc32_update(0, b, sizeof(b) - 4)) {
+        fprintf(stderr, "%s: damaged; counting today's spend from zero\n", e->spend_path);
+        return;
+    }
+    for (int i = 0; i < POLICY_SPEND_HOURS; i++) {
+        e->spend.hour[i] = (int64_t)get_le64(b + 4 + 16 * i);
+        e->spend.amount[i] = (int64_t)get_le64(b + 12 + 16 * i);
+        e->spend.total += e->spend.amount[i];
+    }
+}
+
+// Called with the lock held, after every spend.
+static inline int policy_spend_save(PolicyEngine *e) {
+    unsigned char b[POLICY_SPEND_SIZE];
+    char tmp[1100];
+    memcpy(b, "FZSP", 4);
+    for (int i = 0; i < POLICY_SPEND_HOURS; i++) {
+        put_le64(b + 4 + 16 * i, (uint64_t)e->spend.hour[i]);
+        put_le64(b + 12 + 16 * i, (uint64_t)e->spend.amount[i]);
+    }
+    put_le32(b + sizeof(b) - 4, crc32_update(0, b, sizeof(b) - 4));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", e->spend_path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    int ok = fd >= 0 && write(fd, b, sizeof(b)) == (ssize_t)sizeof(b) && fsync(fd) == 0;
+    if (fd >= 0 && close(fd) != 0) ok = 0;
+    if (ok) ok = rename(tmp, e->spend_path) == 0;
+    if (!ok) perror(e->spend_path);
+    return ok;
+}
+
+// ---------------------------------------------------
+// Checks
+// ---------------------------------------------------
+// Audit records: {"ts":...,"event":...,...} on the engine's log
+// (or, for one-off checks, any log).
+static inline void policy_audit_begin(JsonWriter *j, char *line, size_t cap, const char *event) {
+    char ts[32];
+    audit_timestamp(ts, sizeof(ts));
+    json_init(j, line, cap);
+    json_begin_compact(j);
+    json_kv_str(j, "ts", ts);
+    json_kv_str(j, "event", event);
+}
+
+static inline void policy_audit_end(AuditLog *log, JsonWriter *j, char *line) {
+    json_end_object(j);
+    size_t n = json_finish(j);
+    if (n) audit_log(log, line, n);
+}
+
+static inline void policy_audit(AuditLog *log, PolicyAction a, PolicyVerdict v, const char *arg, const char *why) {
+    char line[AUDIT_SLOT_DATA];
+    JsonWriter j;
+    if (!log) return;
+    policy_audit_begin(&j, line, sizeof(line), "policy");
+    json_kv_str(&j, "action", policy_action_names[a]);
+    if (arg && *arg) json_kv_str(&j, "arg", arg);
+    json_kv_str(&j, "verdict", policy_verdict_names[v]);
+    if (why) json_kv_str(&j, "reason", why);
+    policy_audit_end(log, &j, line);
+}
+
+// fetch needs no engine: only the domains.
+static inline PolicyVerdict policy_fetch(Policy *p, const char *url, char *why, size_t why_n) {
+    char host[256];
+    const char *d = host;
+    if (!url || !policy_host(url, host, sizeof(host))) { snprintf(why, why_n, "no host"); return POLICY_DENY; }
+    // the host itself, then each parent domain
+    while (d && intern_find(&p->domains, d) == INTERN_NONE)
+        d = (d = strchr(d, '.')) ? d + 1 : NULL;
+    if (!d) { snprintf(why, why_n, "%.100s is not an allowed domain", host); return POLICY_DENY; }
+    return POLICY_ALLOW;
+}
+
+// "<microalgo>:<receiver>"; the amount, or 0 when arg is not one.
+static inline int64_t policy_tx_amount(const char *arg) {
+    char *end;
+    long long amount = arg ? strtoll(arg, &end, 10) : 0;
+    if (!arg || end == arg || *end != ':' || !end[1] || strlen(arg) >= POLICY_ARG_MAX) return 0;
+    return amount > 0 ? amount : 0;
+}
+
+// Room for amount more today, counting the holds: a free hold slot, or -1
+// with why set. Called with the lock held; releases lapsed holds.
+static inline int policy_hold_slot(PolicyEngine *e, const Policy *p, int64_t amount, int64_t now,
+                                   char *why, size_t why_n) {
+    int slot = -1;
+    policy_spend_advance(&e->spend, now);
+    for (int i = 0; i < POLICY_HOLDS; i++) {
+        PolicyHold *h = &e->holds[i];
+        if (h->expires && h->expires <= now) { e->held -= h->amount; h->expires = 0; }
+        if (!h->expires && slot < 0) slot = i;
+    }
+    if (amount > p->daily_spend_limit - e->spend.total - e->held) {
+        snprintf(why, why_n, "daily limit: %lld of %lld microalgo spent, %lld awaiting confirmation",
+                 (long long)e->spend.total, (long long)p->daily_spend_limit, (long long)e->held);
+        return -1;
+    }
+    if (slot < 0) snprintf(why, why_n, "too many payments awaiting confirmation");
+    return slot;
+}
+
+// Gives back the hold check id took, unless it lapsed or was confirmed.
+static inline void policy_hold_release(PolicyEngine *e, int slot, uint64_t id) {
+    pthread_mutex_lock(&e->lock);
+    PolicyHold *h = &e->holds[slot];
+    if (h->expires && h->id == id) {
+        e->held -= h->amount;
+        h->expires = 0;
+    }
+    pthread_mutex_unlock(&e->lock);
+}
+
+// Decides one action. For tx, arg is "<microalgo>:<receiver>", and an
+// allowed tx is held against the day until policy_spent confirms it (or
+// the hold lapses): ask only when about to pay. The check that accepts a
+// consent token uses it up. why gets a short reason for anything but an
+// allow.
+static inline PolicyVerdict policy_check(PolicyEngine *e, PolicyAction a, const char *arg, const char *token,
+                                         char *why, size_t why_n) {
+    Policy *p = atomic_load_explicit(&e->current, memory_order_acquire);
+    int64_t now = (int64_t)time(NULL);
+    PolicyVerdict v = POLICY_ALLOW;
+    why[0] = '\0';
+    if (!p) {
+        v = POLICY_DENY;
+        snprintf(why, why_n, "no policy loaded");
+    } else if (p->autonomy == POLICY_OBSERVE) {
+        v = POLICY_DENY;
+        snprintf(why, why_n, "autonomy level is observe");
+    } else if (a == POLICY_FETCH) {
+        v = policy_fetch(p, arg, why, why_n);
+    } else if (a == POLICY_TX) {
+        int64_t amount = policy_tx_amount(arg);
+        if (!amount) {
+            v = POLICY_DENY;
+            snprintf(why, why_n, "expected <microalgo>:<receiver>");
+        } else {
+            // Held before the token is used: a concurrent payment sees the
+            // amount taken, and one refused here keeps its token.
+            uint64_t id = 0;
+            pthread_mutex_lock(&e->lock);
+            int slot = policy_hold_slot(e, p, amount, now, why, why_n);
+            if (slot >= 0) {
+                PolicyHold *h = &e->holds[slot];
+                h->amount = amount;
+                h->expires = now + POLICY_HOLD_SECONDS;
+                h->id = id = ++e->hold_ids;
+                snprintf(h->arg, sizeof(h->arg), "%s", arg);
+                e->held += amount;
+            }
+            pthread_mutex_unlock(&e->lock);
+            if (slot < 0) v = POLICY_DENY;
+            else if (p->autonomy != POLICY_AUTONOMOUS && amount > p->human_tx_over) {
+                v = policy_consent(e, p, token, a, arg, now, why, why_n);
+                if (v == POLICY_CONSENT && !why[0])
+                    snprintf(why, why_n, "over %lld microalgo needs consent", (long long)p->human_tx_over);
+                if (v != POLICY_ALLOW) policy_hold_release(e, slot, id);
+            }
+        }
+    } else {
+        int human = p->autonomy != POLICY_AUTONOMOUS && (a == POLICY_PUBLISH ? p->human_publish : p->human_paid_api);
+        if (human) {
+            v = policy_consent(e, p, token, a, arg, now, why, why_n);
+            if (v == POLICY_CONSENT && !why[0]) snprintf(why, why_n, "%s needs consent", policy_action_names[a]);
+        }
+    }
+    policy_audit(e->audit, a, v, arg, v == POLICY_ALLOW ? NULL : why);
+    return v;
+}
+
+// The payer's report that tx arg ("<microalgo>:<receiver>") went out;
+// txid, if known, is only audited. The spend counts whether or not a
+// hold matches, since the money has gone. Returns 0, with why set, when
+// arg is malformed or the spend could not be saved.
+static inline int policy_spent(PolicyEngine *e, const char *arg, const char *txid, char *why, size_t why_n) {
+    char line[AUDIT_SLOT_DATA];
+    JsonWriter j;
+    int64_t now = (int64_t)time(NULL), amount = policy_tx_amount(arg);
+    int held = 0, ok = 1;
+    why[0] = '\0';
+    if (!amount) { snprintf(why, why_n, "expected <microalgo>:<receiver>"); return 0; }
+    pthread_mutex_lock(&e->lock);
+    for (int i = 0; i < POLICY_HOLDS && !held; i++) {
+        PolicyHold *h = &e->holds[i];
+        if (h->expires && strcmp(h->arg, arg) == 0) {
+            e->held -= h->amount;
+            h->expires = 0;
+            held = 1;
+        }
+    }
+    policy_spend_advance(&e->spend, now);
+    policy_spend_add(&e->spend, now, amount);
+    if (!policy_spend_save(e)) { ok = 0; snprintf(why, why_n, "counted, but could not save the spend"); }
+    pthread_mutex_unlock(&e->lock);
+    if (e->audit) {
+        policy_audit_begin(&j, line, sizeof(line), "spend");
+        json_kv_str(&j, "arg", arg);
+        if (txid && *txid) json_kv_str(&j, "txid", txid);
+        json_kv_int(&j, "held", held);
+        if (!ok) json_kv_str(&j, "reason", why);
+        policy_audit_end(e->audit, &j, line);
+    }
+    return ok;
+}
+
+static inline int policy_action(const char *name, PolicyAction *a) {
+    for (int i = 0; i < POLICY_NACTIONS; i++)
+        if (strcmp(name, policy_action_names[i]) == 0) { *a = (PolicyAction)i; return 1; }
+    return 0;
+}
+
+// ---------------------------------------------------
+// Loading and hot reload
+// ---------------------------------------------------
+static inline int policy_same_file(const struct stat *a, const struct stat *b) {
+#ifdef __APPLE__
+    return a->st_ino == b->st_ino && a->st_size == b->st_size &&
+           a->st_mtimespec.tv_sec == b->st_mtimespec.tv_sec && a->st_mtimespec.tv_nsec == b->st_mtimespec.tv_nsec;
+#else
+    return a->st_ino == b->st_ino && a->st_size == b->st_size &&
+           a->st_mtim.tv_sec == b->st_mtim.tv_sec && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+#endif
+}
+
+// Compiles the file and publishes it. Readers may still hold the policy it
+// replaces, so that one is kept (on the new one's retired list) until close.
+static inline int policy_reload(PolicyEngine *e) {
+    char err[256], line[AUDIT_SLOT_DATA];
+    JsonWriter j;
+    struct stat st;
+    if (stat(e->path, &st) != 0) {
+        memset(&st, 0, sizeof(st));
+        // no file and nothing loaded yet is simply no policy
+        if (errno == ENOENT && !atomic_load_explicit(&e->current, memory_order_acquire)) {
+            e->seen = st;
+            return 0;
+        }
+    }
+    Policy *p = policy_compile(e->path, err, sizeof(err));
+    e->seen = st;
+    if (!p) {
+        fprintf(stderr, "%s: %s; keeping the current policy\n", e->path, err);
+        if (e->audit) {
+            policy_audit_begin(&j, line, sizeof(line), "policy_rejected");
+            json_kv_str(&j, "file", e->path);
+            json_kv_str(&j, "reason", err);
+            policy_audit_end(e->audit, &j, line);
+        }
+        return 0;
+    }
+    p->generation = ++e->generations;
+    Policy *old = atomic_exchange_explicit(&e->current, p, memory_order_acq_rel);
+    p->retired = old;
+    if (e->audit) {
+        policy_audit_begin(&j, line, sizeof(line), "policy_loaded");
+        json_kv_str(&j, "file", e->path);
+        json_kv_int(&j, "generation", (long long)p->generation);
+        json_kv_int(&j, "domains", p->domains.count);
+        policy_audit_end(e->audit, &j, line);
+    }
+    return 1;
+}
+
+static inline void *policy_watcher_main(void *arg) {
+    PolicyEngine *e = arg;
+    const char *base = strrchr(e->path, '/');
+    base = base ? base + 1 : e->path;
+    for (;;) {
+        struct pollfd fds[2] = { { e->stop[0], POLLIN, 0 }, { e->watch_fd, POLLIN, 0 } };
+        int n = poll(fds, e->watch_fd >= 0 ? 2 : 1, e->watch_fd >= 0 ? -1 : POLICY_POLL_MS);
+        if (n < 0 && errno != EINTR) break;
+        if (fds[0].revents) break;
+        int changed = 0;
+#ifdef __linux__
+        if (e->watch_fd >= 0 && (fds[1].revents & POLLIN)) {
+            char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+            ssize_t len = read(e->watch_fd, buf, sizeof(buf));
+            for (char *q = buf; len > 0 && q < buf + len;) {
+                struct inotify_event *ev = (struct inotify_event *)q;
+                if (ev->len && strcmp(ev->name, base) == 0) changed = 1;
+                q += sizeof(*ev) + ev->len;
+            }
+        }
+#endif
+        if (e->watch_fd < 0) {
+            struct stat st;
+            changed = stat(e->path, &st) == 0 && !policy_same_file(&st, &e->seen);
+        }
+        if (changed) policy_reload(e);
+    }
+    return NULL;
+}
+
+// Loads path (the spend record lives in spend_path, used consent nonces
+// in nonce_path) and watches it for changes. Returns 0 when there is no
+// file or the first load fails; checks then deny.
+static inline int policy_open(PolicyEngine *e, const char *path, const char *spend_path, const char *nonce_path,
+                              AuditLog *audit) {
+    memset(e, 0, sizeof(*e));
+    snprintf(e->path, sizeof(e->path), "%s", path);
+    snprintf(e->spend_path, sizeof(e->spend_path), "%s", spend_path);
+    snprintf(e->nonce_path, sizeof(e->nonce_path), "%s", nonce_path);
+    e->audit = audit;
+    e->watch_fd = -1;
+    e->nonces.fd = -1;
+    pthread_mutex_init(&e->lock, NULL);
+    policy_spend_load(e);
+    int ok = policy_reload(e);
+
+#ifdef __linux__
+    // the directory, since editors save by writing a new file and renaming it
+    char dir[1024];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *slash = strrchr(dir, '/');
+    if (slash) *slash = '\0';
+    else snprintf(dir, sizeof(dir), ".");
+    e->watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (e->watch_fd >= 0 && inotify_add_watch(e->watch_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(e->watch_fd);
+        e->watch_fd = -1;
+    }
+#endif
+    if (pipe(e->stop) == 0) e->watching = pthread_create(&e->watcher, NULL, policy_watcher_main, e) == 0;
+    return ok;
+}
+
+// Stops the watcher and frees every policy, including replaced ones.
+static inline void policy_close(PolicyEngine *e) {
+    if (e->watching) {
+        if (write(e->stop[1], "x", 1) < 0) perror("policy_close");
+        pthread_join(e->watcher, NULL);
+        e->watching = 0;
+    }
+    if (e->stop[0] > 0) { close(e->stop[0]); close(e->stop[1]); }
+    if (e->watch_fd >= 0) close(e->watch_fd);
+    policy_free(atomic_exchange(&e->current, NULL));
+    policy_nonces_close(&e->nonces);
+    pthread_mutex_destroy(&e->lock);
+}
+
+// One-line summary for the policy command.
+static inline void policy_describe(FILE *out, PolicyEngine *e) {
+    static const char *levels[] = { "observe", "act-with-approval", "autonomous" };
+    Policy *p = atomic_load_explicit(&e->current, memory_order_acquire);
+    if (!p) { fprintf(out, "No policy loaded from %s.\n", e->path); return; }
+    pthread_mutex_lock(&e->lock);
+    policy_spend_advance(&e->spend, (int64_t)time(NULL));
+    long long spent = (long long)e->spend.total, held = (long long)e->held;
+    pthread_mutex_unlock(&e->lock);
+    fprintf(out, "Policy %llu from %s: %s, %lld of %lld microalgo spent in the last day (%lld held), ",
+            (unsigned long long)p->generation, e->path, levels[p->autonomy], spent, (long long)p->daily_spend_limit,
+            held);
+    if (p->autonomy == POLICY_ACT_WITH_APPROVAL)
+        fprintf(out, "consent over %lld microalgo%s%s, ", (long long)p->human_tx_over,
+                p->human_publish ? " and to publish" : "", p->human_paid_api ? " and for paid APIs" : "");
+    fprintf(out, "%u allowed domains, tokens last %us%s.\n", p->domains.count, p->ttl,
+            p->key_n ? "" : " (no consent key: none will verify)");
+}
+
+#endif // FORENZO_POLICY_H
@@ -0,0 +1,160 @@
+// forenzo_postings.h — per-collection posting lists over record numbers
+// Keys are dense collection ids (from the interning dictionary); each key
+// maps to the ascending list of records in that collection, so "all
+// records in collection X" and per-collection counts need no scan.
+// Persisted as an append-only sidecar of 12-byte little-endian records
+// (u32 key, u64 record) in record order; the owner replays any records
+// the sidecar is missing (see posting_index_total()). A snapshot section
+// (forenzo_snapshot.h) can stand in for the sidecar's older records.
+
+#ifndef FORENZO_POSTINGS_H
+#define FORENZO_POSTINGS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "forenzo_log.h"
+#include "forenzo_endian.h"
+#include "forenzo_snapshot.h"
+
+#define POSTING_RECORD_SIZE 12
+
+typedef struct {
+    uint64_t *records;
+    uint32_t n, cap;
+} PostingList;
+
+typedef struct {
+    PostingList *lists;     // indexed by key
+    uint32_t nlists;
+    uint64_t total;         // records indexed; also the next record expected
+    LogWriter w;
+    char path[1024];
+    off_t held;             // sidecar bytes the snapshot holds, dropped on close
+} PostingIndex;
+
+static inline int posting_insert(PostingIndex *ix, uint32_t key, uint64_t record) {
+    if (key >= ix->nlists) {
+        uint32_t n = ix->nlists ? ix->nlists : 64;
+        while (n <= key) n *= 2;
+        PostingList *l = realloc(ix->lists, n * sizeof(PostingList));
+        if (!l) return 0;
+        memset(l + ix->nlists, 0, (n - ix->nlists) * sizeof(PostingList));
+        ix->lists = l;
+        ix->nlists = n;
+    }
+    PostingList *p = &ix->lists[key];
+    if (p->n == p->cap) {
+        uint32_t cap = p->cap ? p->cap * 2 : 8;
+        uint64_t *r = realloc(p->records, cap * sizeof(uint64_t));
+        if (!r) return 0;
+        p->records = r;
+        p->cap = cap;
+    }
+    p->records[p->n++] = record;
+    if (record >= ix->total) ix->total = record + 1;
+    return 1;
+}
+
+// Index record under key (records must arrive in ascending order).
+static inline void posting_add(PostingIndex *ix, uint32_t key, uint64_t record) {
+    if (!posting_insert(ix, key, record)) return;
+    unsigned char rec[POSTING_RECORD_SIZE];
+    put_le32(rec, key);
+    put_le64(rec + 4, record);
+    log_writer_append(&ix->w, rec, sizeof(rec), NULL);
+}
+
+static inline const PostingList *posting_get(const PostingIndex *ix, uint32_t key) {
+    return key < ix->nlists ? &ix->lists[key] : NULL;
+}
+
+static inline uint32_t posting_count(const PostingIndex *ix, uint32_t key) {
+    return key < ix->nlists ? ix->lists[key].n : 0;
+}
+
+// Records already indexed; the owner indexes [total, its own count).
+static inline uint64_t posting_index_total(const PostingIndex *ix) {
+    return ix->total;
+}
+
+// ---------------------------------------------------
+// Snapshot section: u32 nlists, then per key u32 n, u64 records[n]
+// ---------------------------------------------------
+static inline void posting_index_snapshot(const PostingIndex *ix, SnapWriter *w, uint32_t tag) {
+    uint64_t records = 0;
+    for (uint32_t k = 0; k < ix->nlists; k++) records += ix->lists[k].n;
+    snap_section(w, tag, 4 + (uint64_t)ix->nlists * 4 + records * 8);
+    snap_u32(w, ix->nlists);
+    for (uint32_t k = 0; k < ix->nlists; k++) {
+        const PostingList *p = &ix->lists[k];
+        snap_u32(w, p->n);
+        for (uint32_t i = 0; i < p->n; i++) snap_u64(w, p->records[i]);
+    }
+}
+
+// Fill a fresh index from a snapshot taken after `records` entries.
+static inline int posting_index_restore(PostingIndex *ix, const unsigned char *d, uint64_t len,
+                                        uint64_t records) {
+    if (len < 4) return 0;
+    uint32_t nlists = get_le32(d);
+    uint64_t at = 4;
+    for (uint32_t k = 0; k < nlists; k++) {
+        if (at + 4 > len) return 0;
+        uint32_t n = get_le32(d + at);
+        at += 4;
+        if (at + (uint64_t)n * 8 > len) return 0;
+        if (n) {
+            if (!posting_insert(ix, k, get_le64(d + at))) return 0;
+            PostingList *p = &ix->lists[k];
+            uint64_t *r = realloc(p->records, n * sizeof(uint64_t));
+            if (!r) return 0;
+            p->records = r;
+            p->cap = p->n = n;
+            for (uint32_t i = 0; i < n; i++) r[i] = get_le64(d + at + (uint64_t)i * 8);
+        }
+        at += (uint64_t)n * 8;
+    }
+    ix->total = records;
+    return 1;
+}
+
+// ---------------------------------------------------
+// Open / Close
+// ---------------------------------------------------
+// Loads the sidecar into ix (fresh, or filled by posting_index_restore),
+// skipping records it already holds and dropping a torn tail, a gap, and
+// anything at or beyond `records` (entries the owner no longer has).
+static inline int posting_index_open(PostingIndex *ix, const char *path,
+                                     uint64_t records, LogPolicy policy) {
+    FILE *f = fopen(path, "rb");
+    off_t good = 0, held = 0;
+    if (f) {
+        uint64_t base = ix->total;
+        unsigned char rec[POSTING_RECORD_SIZE];
+        while (fread(rec, 1, sizeof(rec), f) == sizeof(rec)) {
+            uint64_t record = get_le64(rec + 4);
+            if (record >= records || record > ix->total) break;
+            if (record < base) held += POSTING_RECORD_SIZE;
+            else posting_insert(ix, get_le32(rec), record);
+            good += POSTING_RECORD_SIZE;
+        }
+        fclose(f);
+        if (truncate(path, good) != 0) perror("truncate posting index");
+    }
+    snprintf(ix->path, sizeof(ix->path), "%s", path);
+    ix->held = held;
+    return log_writer_open(&ix->w, path, policy);
+}
+
+static inline void posting_index_close(PostingIndex *ix) {
+    log_writer_close(&ix->w);
+    snap_drop_prefix(ix->path, ix->held);
+    for (uint32_t k = 0; k < ix->nlists; k++) free(ix->lists[k].records);
+    free(ix->lists);
+    memset(ix, 0, sizeof(*ix));
+}
+
+#endif // FORENZO_POSTINGS_H
@@ -0,0 +1,96 @@
+// forenzo_prime.h — shared prime oracle for Forel's Breath
+// An odd-only bitset sieve that doubles itself on demand, plus a cached
+// factor -> tick table, so nearest_prime() and euler_prime_step() are
+// table lookups instead of trial division on every appended entry.
+// Not thread-safe: callers serialize appends already.
+
+#ifndef FORENZO_PRIME_H
+#define FORENZO_PRIME_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define PRIME_SIEVE_INITIAL 65536
+
+typedef struct {
+    uint64_t *bits;     // bit k set <=> 2k+1 is prime
+    uint64_t limit;     // every odd number < limit is classified
+    int *ticks;         // ticks[f] = euler_prime_step(f), 0 = not cached
+    size_t nticks;
+} PrimeOracle;
+
+static PrimeOracle prime_oracle;
+
+// ---------------------------------------------------
+// Sieve (re-sieves from scratch at twice the size)
+// ---------------------------------------------------
+static int prime_sieve_grow(uint64_t want) {
+    uint64_t limit = prime_oracle.limit ? prime_oracle.limit : PRIME_SIEVE_INITIAL;
+    while (limit <= want) limit *= 2;
+    uint64_t nbits = limit / 2;
+    size_t words = (size_t)((nbits + 63) / 64);
+    uint64_t *bits = malloc(words * sizeof(uint64_t));
+    if (!bits) return 0;
+    memset(bits, 0xff, words * sizeof(uint64_t));
+    bits[0] &= ~1ull;                                  // 1 is not prime
+    for (uint64_t p = 3; p * p < limit; p += 2) {
+        if (!(bits[p / 128] >> ((p / 2) % 64) & 1)) continue;
+        for (uint64_t m = p * p; m < limit; m += 2 * p)
+            bits[m / 128] &= ~(1ull << ((m / 2) % 64));
+    }
+    free(prime_oracle.bits);
+    prime_oracle.bits = bits;
+    prime_oracle.limit = limit;
+    return 1;
+}
+
+// Smallest prime >= n.
+static uint64_t prime_at_or_above(uint64_t n) {
+    if (n <= 2) return 2;
+    if (!(n & 1)) n++;
+    for (;;) {
+        if (n >= prime_oracle.limit && !prime_sieve_grow(n * 2)) return 0;
+        uint64_t k = n / 2, words = (prime_oracle.limit / 2 + 63) / 64;
+        uint64_t w = prime_oracle.bits[k / 64] & (~0ull << (k % 64));
+        for (uint64_t i = k / 64;;) {
+            if (w) {
+                uint64_t p = 2 * (i * 64 + (uint64_t)__builtin_ctzll(w)) + 1;
+                if (p < prime_oracle.limit) return p;
+                break;
+            }
+            if (++i >= words) break;
+            w = prime_oracle.bits[i];
+        }
+        n = prime_oracle.limit | 1;                    // ran off the end: extend
+    }
+}
+
+// ---------------------------------------------------
+// Euler-prime harmonic (Forel's Breath)
+// ---------------------------------------------------
+static int nearest_prime(int n) {
+    return (int)prime_at_or_above(n < 2 ? 2 : (uint64_t)n);
+}
+
+static int euler_prime_step(int factor) {
+    if (factor < 0) factor = 0;
+    if ((size_t)factor >= prime_oracle.nticks) {
+        size_t n = prime_oracle.nticks ? prime_oracle.nticks : 1024;
+        while (n <= (size_t)factor) n *= 2;
+        int *t = realloc(prime_oracle.ticks, n * sizeof(int));
+        if (!t) return nearest_prime((int)(2.718281828 * factor + 0.5));
+        memset(t + prime_oracle.nticks, 0, (n - prime_oracle.nticks) * sizeof(int));
+        prime_oracle.ticks = t;
+        prime_oracle.nticks = n;
+    }
+    int *tick = &prime_oracle.ticks[factor];
+    if (!*tick) {
+        double e = 2.718281828;
+        int rounded = (int)(e * factor + 0.5);
+        *tick = nearest_prime(rounded);
+    }
+    return *tick;
+}
+
+#endif // FORENZO_PRIME_H
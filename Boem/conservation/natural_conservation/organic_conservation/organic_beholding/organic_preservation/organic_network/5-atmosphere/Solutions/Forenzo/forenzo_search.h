@@ -0,0 +1,450 @@
+// forenzo_search.h — incremental full-text index over preserved entries
+// Text is split into lower-cased alphanumeric terms (bytes >= 0x80 count
+// as letters, so UTF-8 words stay whole). Terms are interned to dense ids;
+// each id owns a posting list of (record, term frequency) pairs kept in
+// memory as varint deltas, so a list costs ~2 bytes per hit.
+//
+// Terms longer than SEARCH_TERM_MAX bytes are cut to their first
+// SEARCH_TERM_MAX (at a UTF-8 boundary), in queries as in the index.
+//
+// Persisted as an append-only sidecar with one block per entry:
+//   u32 LE payload length, then varints: record, nterms, (term, tf)*
+// Term strings go to their own dictionary (forenzo_intern.h), which is
+// flushed before any block naming them. The owner replays entries the
+// sidecar is missing (see search_index_total()).
+//
+// A snapshot (forenzo_snapshot.h) holds every term's posting list as of
+// its record count, laid out per term so the mapped file serves queries
+// directly: only the lists a query names are paged in, and only the
+// sidecar blocks after the snapshot are replayed into memory.
+//
+// Queries rank by tf-idf: sum over query terms of
+//   (1 + log tf) * log(1 + N / df),
+// accumulated over the matching records only.
+
+#ifndef FORENZO_SEARCH_H
+#define FORENZO_SEARCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include "forenzo_log.h"
+#include "forenzo_endian.h"
+#include "forenzo_varint.h"
+#include "forenzo_intern.h"
+#include "forenzo_snapshot.h"
+
+#define SEARCH_TERM_MIN 2
+#define SEARCH_TERM_MAX 32
+
+typedef struct {
+    unsigned char *bytes;   // varint (record delta, tf) pairs
+    uint32_t len, cap;
+    uint32_t df;            // entries containing the term
+    uint64_t last;          // last record, base for the next delta
+} TermPostings;
+
+typedef struct {
+    InternTable terms;
+    TermPostings *lists;    // indexed by term id; records after the snapshot
+    uint32_t nlists;
+    const unsigned char *base;      // mapped snapshot section, or NULL
+    uint64_t base_len;
+    uint32_t nbase;                 // terms in the snapshot's directory
+    uint64_t total;         // entries indexed; also the next record expected
+    LogWriter w;
+    char path[1024];
+    off_t held;             // sidecar bytes the snapshot holds, dropped on close
+} SearchIndex;
+
+typedef struct {
+    uint64_t record;
+    double score;
+} SearchHit;
+
+// ---------------------------------------------------
+// Tokenizer
+// ---------------------------------------------------
+// Calls emit(term, len, ctx) for every term in s.
+static inline void search_tokenize(const char *s, void (*emit)(const char *, size_t, void *), void *ctx) {
+    char term[SEARCH_TERM_MAX + 2];
+    size_t n = 0;
+    for (const unsigned char *p = (const unsigned char *)s;; p++) {
+        unsigned char c = *p;
+        int word = (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80 ||
+                   (c >= 'A' && c <= 'Z');
+        if (word) {
+            if (n <= SEARCH_TERM_MAX) term[n] = (char)(c >= 'A' && c <= 'Z' ? c + 32 : c);
+            n++;
+            continue;
+        }
+        if (n > SEARCH_TERM_MAX) {      // keep whole characters only
+            n = SEARCH_TERM_MAX;
+            while (n > 0 && ((unsigned char)term[n] & 0xC0) == 0x80) n--;
+        }
+        if (n >= SEARCH_TERM_MIN) { term[n] = '\0'; emit(term, n, ctx); }
+        n = 0;
+        if (!c) break;
+    }
+}
+
+// ---------------------------------------------------
+// Postings
+// ---------------------------------------------------
+static inline int search_post(SearchIndex *ix, uint32_t term, uint64_t record, uint32_t tf) {
+    if (term >= ix->nlists) {
+        uint32_t n = ix->nlists ? ix->nlists : 1024;
+        while (n <= term) n *= 2;
+        TermPostings *l = realloc(ix->lists, n * sizeof(TermPostings));
+        if (!l) return 0;
+        memset(l + ix->nlists, 0, (n - ix->nlists) * sizeof(TermPostings));
+        ix->lists = l;
+        ix->nlists = n;
+    }
+    TermPostings *p = &ix->lists[term];
+    if (p->len + 20 > p->cap) {
+        uint32_t cap = p->cap ? p->cap * 2 : 32;
+        unsigned char *b = realloc(p->bytes, cap);
+        if (!b) return 0;
+        p->bytes = b;
+        p->cap = cap;
+    }
+    p->len += (uint32_t)varint_put(p->bytes + p->len, p->df ? record - p->last : record);
+    p->len += (uint32_t)varint_put(p->bytes + p->len, tf);
+    p->last = record;
+    p->df++;
+    return 1;
+}
+
+typedef struct {
+    SearchIndex *ix;
+    uint32_t *ids;
+    size_t n, cap;
+} TermCollector;
+
+static inline void search_collect(const char *term, size_t n, void *ctx) {
+    TermCollector *tc = ctx;
+    uint32_t id = intern_insert(&tc->ix->terms, term, n, 1);
+    if (id == INTERN_NONE) return;
+    if (tc->n == tc->cap) {
+        size_t cap = tc->cap ? tc->cap * 2 : 64;
+        uint32_t *ids = realloc(tc->ids, cap * sizeof(uint32_t));
+        if (!ids) return;
+        tc->ids = ids;
+        tc->cap = cap;
+    }
+    tc->ids[tc->n++] = id;
+}
+
+static inline int search_cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Index one entry's text (records must arrive in ascending order).
+static inline void search_index_add(SearchIndex *ix, uint64_t record, const char *const *texts, int ntexts) {
+    TermCollector tc = { ix, NULL, 0, 0 };
+    for (int t = 0; t < ntexts; t++)
+        if (texts[t]) search_tokenize(texts[t], search_collect, &tc);
+    qsort(tc.ids, tc.n, sizeof(uint32_t), search_cmp_u32);
+
+    // Block: length placeholder, record, nterms, (term, tf)*
+    unsigned char *blk = malloc(4 + 20 + tc.n * 10);
+    size_t len = 4, nterms = 0;
+    for (size_t i = 0; i < tc.n;) {
+        size_t j = i;
+        while (j < tc.n && tc.ids[j] == tc.ids[i]) j++;
+        nterms++;
+        i = j;
+    }
+    if (blk) {
+        len += varint_put(blk + len, record);
+        len += varint_put(blk + len, nterms);
+    }
+    for (size_t i = 0; i < tc.n;) {
+        size_t j = i;
+        while (j < tc.n && tc.ids[j] == tc.ids[i]) j++;
+        search_post(ix, tc.ids[i], record, (uint32_t)(j - i));
+        if (blk) {
+            len += varint_put(blk + len, tc.ids[i]);
+            len += varint_put(blk + len, j - i);
+        }
+        i = j;
+    }
+    if (record >= ix->total) ix->total = record + 1;
+    if (blk) {
+        put_le32(blk, (uint32_t)(len - 4));
+        log_writer_append(&ix->w, blk, len, NULL);
+        free(blk);
+    }
+    free(tc.ids);
+}
+
+// Entries already indexed; the owner indexes [total, its own count).
+static inline uint64_t search_index_total(const SearchIndex *ix) {
+    return ix->total;
+}
+
+// Term t's list in the mapped snapshot; 0 when it has none there.
+static inline int search_base_list(const SearchIndex *ix, uint32_t t, uint32_t *df, uint64_t *last,
+                                   const unsigned char **bytes, uint32_t *len) {
+    if (t >= ix->nbase) return 0;
+    const unsigned char *e = ix->base + 4 + (uint64_t)t * 24;
+    uint64_t area = 4 + (uint64_t)ix->nbase * 24, off = get_le64(e + 12);
+    *df = get_le32(e);
+    *last = get_le64(e + 4);
+    *len = get_le32(e + 20);
+    if (off > ix->base_len - area || *len > ix->base_len - area - off) return 0;
+    *bytes = ix->base + area + off;
+    return *df > 0;
+}
+
+// Entries containing term t.
+static inline uint64_t search_df(const SearchIndex *ix, uint32_t t) {
+    uint32_t df = 0, len;
+    uint64_t last;
+    const unsigned char *b;
+    if (!search_base_list(ix, t, &df, &last, &b, &len)) df = 0;
+    return df + (t < ix->nlists ? ix->lists[t].df : 0);
+}
+
+// ---------------------------------------------------
+// Query
+// ---------------------------------------------------
+typedef struct {
+    SearchIndex *ix;
+    uint32_t ids[64];
+    size_t n;
+} QueryTerms;
+
+static inline void search_query_term(const char *term, size_t n, void *ctx) {
+    QueryTerms *q = ctx;
+    uint32_t id = intern_find(&q->ix->terms, term);
+    (void)n;
+    if (id == INTERN_NONE || q->n == sizeof(q->ids) / sizeof(q->ids[0])) return;
+    for (size_t i = 0; i < q->n; i++) if (q->ids[i] == id) return;
+    q->ids[q->n++] = id;
+}
+
+// Scores of the records a query matches, open addressing on record + 1
+// (0 marks a free slot); sized for every posting, so it never fills.
+typedef struct {
+    uint64_t key;
+    float score;
+} ScoreSlot;
+
+static inline void search_score_list(ScoreSlot *map, size_t mask, const unsigned char *bytes,
+                                     uint32_t len, uint32_t df, double idf, uint64_t total) {
+    uint64_t record = 0, v, tf;
+    for (uint32_t off = 0, k = 0; k < df; k++) {
+        size_t a = varint_get(bytes + off, len - off, &v);
+        record = k ? record + v : v;
+        size_t b = a ? varint_get(bytes + off + a, len - off - a, &tf) : 0;
+        if (!a || !b) break;
+        off += (uint32_t)(a + b);
+        if (record >= total) break;
+        size_t i = (size_t)((record + 1) * 0x9E3779B97F4A7C15ull >> 20) & mask;
+        while (map[i].key && map[i].key != record + 1) i = (i + 1) & mask;
+        map[i].key = record + 1;
+        map[i].score += (float)((1.0 + log((double)tf)) * idf);
+    }
+}
+
+// Higher score first; the older record wins a tie.
+static inline int search_better(float score, uint64_t record, const SearchHit *h) {
+    return score > h->score || (score == h->score && record < h->record);
+}
+
+// Best `max` hits for the query, highest score first. Returns hits found.
+static inline size_t search_query(SearchIndex *ix, const char *query, SearchHit *hits, size_t max) {
+    QueryTerms q = { .ix = ix };
+    search_tokenize(query, search_query_term, &q);
+    if (!q.n || !ix->total || !max) return 0;
+
+    uint64_t postings = 0;
+    for (size_t t = 0; t < q.n; t++) postings += search_df(ix, q.ids[t]);
+    if (!postings) return 0;
+    size_t slots = 16;
+    while (slots < 2 * postings) slots *= 2;
+    ScoreSlot *map = calloc(slots, sizeof(ScoreSlot));
+    if (!map) return 0;
+    for (size_t t = 0; t < q.n; t++) {
+        uint32_t id = q.ids[t], df, len;
+        uint64_t last, all = search_df(ix, id);
+        const unsigned char *bytes;
+        if (!all) continue;
+        double idf = log(1.0 + (double)ix->total / (double)all);
+        if (search_base_list(ix, id, &df, &last, &bytes, &len))
+            search_score_list(map, slots - 1, bytes, len, df, idf, ix->total);
+        if (id < ix->nlists && ix->lists[id].df) {
+            const TermPostings *p = &ix->lists[id];
+            search_score_list(map, slots - 1, p->bytes, p->len, p->df, idf, ix->total);
+        }
+    }
+
+    // Top-k by insertion; k is small
+    size_t found = 0;
+    for (size_t i = 0; i < slots; i++) {
+        if (!map[i].key || map[i].score <= 0) continue;
+        uint64_t r = map[i].key - 1;
+        float score = map[i].score;
+        if (found == max && !search_better(score, r, &hits[max - 1])) continue;
+        size_t at = found < max ? found++ : max - 1;
+        while (at > 0 && search_better(score, r, &hits[at - 1])) { hits[at] = hits[at - 1]; at--; }
+        hits[at] = (SearchHit){ r, score };
+    }
+    free(map);
+    return found;
+}
+
+// ---------------------------------------------------
+// Snapshot section: u32 nlists, a directory of
+//   u32 df, u64 last, u64 offset, u32 len
+// per term, then the lists' bytes (offsets count from the end of the
+// directory). Each list is the snapshot's part merged with the records
+// since, which continues it with one re-encoded delta.
+// ---------------------------------------------------
+typedef struct {
+    uint32_t df, len;
+    uint64_t last;
+    const unsigned char *base, *tail;
+    uint32_t base_len, tail_len, tail_skip;     // tail_skip: its absolute first record
+    unsigned char delta[VARINT_MAX];
+    uint32_t delta_len;
+} SnapTermList;
+
+static inline void search_snap_list(const SearchIndex *ix, uint32_t t, SnapTermList *l) {
+    uint32_t bdf = 0;
+    uint64_t blast = 0, first = 0;
+    memset(l, 0, sizeof(*l));
+    if (search_base_list(ix, t, &bdf, &blast, &l->base, &l->base_len)) {
+        l->df = bdf;
+        l->last = blast;
+        l->len = l->base_len;
+    }
+    const TermPostings *p = t < ix->nlists ? &ix->lists[t] : NULL;
+    if (!p || !p->df) return;
+    l->tail = p->bytes;
+    l->tail_len = p->len;
+    if (l->df) {
+        l->tail_skip = (uint32_t)varint_get(p->bytes, p->len, &first);
+        l->delta_len = (uint32_t)varint_put(l->delta, first - blast);
+    }
+    l->df += p->df;
+    l->last = p->last;
+    l->len += l->delta_len + l->tail_len - l->tail_skip;
+}
+
+static inline void search_index_snapshot(const SearchIndex *ix, SnapWriter *w, uint32_t tag) {
+    uint32_t nlists = ix->nlists > ix->nbase ? ix->nlists : ix->nbase;
+    SnapTermList l;
+    uint64_t bytes = 0;
+    for (uint32_t t = 0; t < nlists; t++) {
+        search_snap_list(ix, t, &l);
+        bytes += l.len;
+    }
+    snap_section(w, tag, 4 + (uint64_t)nlists * 24 + bytes);
+    snap_u32(w, nlists);
+    uint64_t off = 0;
+    for (uint32_t t = 0; t < nlists; t++) {
+        search_snap_list(ix, t, &l);
+        snap_u32(w, l.df);
+        snap_u64(w, l.last);
+        snap_u64(w, off);
+        snap_u32(w, l.len);
+        off += l.len;
+    }
+    for (uint32_t t = 0; t < nlists; t++) {
+        search_snap_list(ix, t, &l);
+        snap_write(w, l.base, l.base_len);
+        snap_write(w, l.delta, l.delta_len);
+        if (l.tail) snap_write(w, l.tail + l.tail_skip, l.tail_len - l.tail_skip);
+    }
+}
+
+// Serve a fresh index's postings from a snapshot section taken after
+// `records` entries; d must stay mapped until search_index_close (the
+// term dictionary is loaded by search_index_open).
+static inline int search_index_restore(SearchIndex *ix, const unsigned char *d, uint64_t len,
+                                       uint64_t records) {
+    if (len < 4 || (len - 4) / 24 < get_le32(d)) return 0;
+    ix->base = d;
+    ix->base_len = len;
+    ix->nbase = get_le32(d);
+    ix->total = records;
+    return 1;
+}
+
+// ---------------------------------------------------
+// Open / Close
+// ---------------------------------------------------
+// Loads the term dictionary and sidecar into ix (fresh, or filled by
+// search_index_restore), skipping blocks it already holds and dropping
+// a torn tail, a gap, and any block at or beyond `records` (entries the
+// owner no longer has).
+static inline int search_index_open(SearchIndex *ix, const char *path, const char *terms_path,
+                                    uint64_t records, LogPolicy policy) {
+    if (!intern_open(&ix->terms, terms_path)) return 0;
+    FILE *f = fopen(path, "rb");
+    off_t good = 0, held = 0;
+    if (f) {
+        uint64_t base = ix->total;
+        struct stat st;
+        off_t size = fstat(fileno(f), &st) == 0 ? st.st_size : 0;
+        unsigned char hdr[4], *blk = NULL;
+        size_t cap = 0;
+        while (fread(hdr, 1, 4, f) == 4) {
+            size_t n = get_le32(hdr), at = 0, k;
+            if (n > cap) { cap = n; blk = realloc(blk, cap); }
+            // blocks the snapshot holds are only stepped over
+            size_t head = n < VARINT_MAX ? n : VARINT_MAX;
+            if (!blk || fread(blk, 1, head, f) != head) break;
+            uint64_t record, nterms, term, tf;
+            if (!(k = varint_get(blk, head, &record)) || record >= records || record > ix->total) break;
+            if (record < base) {
+                if ((off_t)(n + 4) > size - good || fseeko(f, (off_t)(n - head), SEEK_CUR) != 0) break;
+                held += (off_t)(n + 4);
+                good += (off_t)(n + 4);
+                continue;
+            }
+            if (fread(blk + head, 1, n - head, f) != n - head) break;
+            at += k;
+            if (!(k = varint_get(blk + at, n - at, &nterms))) break;
+            at += k;
+            int ok = 1;
+            for (int pass = 0; ok && pass < 2; pass++) {      // check the block, then post it
+                size_t p = at;
+                for (uint64_t t = 0; ok && t < nterms; t++) {
+                    size_t a = varint_get(blk + p, n - p, &term);
+                    size_t b = a ? varint_get(blk + p + a, n - p - a, &tf) : 0;
+                    ok = a && b && term < ix->terms.count;
+                    if (ok && pass) search_post(ix, (uint32_t)term, record, (uint32_t)tf);
+                    p += a + b;
+                }
+            }
+            if (!ok) break;
+            if (record >= ix->total) ix->total = record + 1;
+            good += (off_t)(n + 4);
+        }
+        free(blk);
+        fclose(f);
+        if (truncate(path, good) != 0) perror("truncate search index");
+    }
+    snprintf(ix->path, sizeof(ix->path), "%s", path);
+    ix->held = held;
+    return log_writer_open(&ix->w, path, policy);
+}
+
+static inline void search_index_close(SearchIndex *ix) {
+    log_writer_close(&ix->w);
+    snap_drop_prefix(ix->path, ix->held);
+    intern_close(&ix->terms);
+    for (uint32_t t = 0; t < ix->nlists; t++) free(ix->lists[t].bytes);
+    free(ix->lists);
+    memset(ix, 0, sizeof(*ix));
+}
+
+#endif // FORENZO_SEARCH_H
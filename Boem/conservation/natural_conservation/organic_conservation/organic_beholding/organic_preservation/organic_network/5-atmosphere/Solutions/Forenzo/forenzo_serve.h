@@ -0,0 +1,560 @@
+// forenzo_serve.h — local daemon: REPL commands over a Unix domain socket
+// One event loop (epoll on Linux, poll elsewhere) owns every connection
+// and parses complete lines. Commands that change state go to a single
+// appender thread, which runs whatever has queued up as one batch under
+// the write lock; everything else goes to a pool of reader threads that
+// share the read lock. Replies are built in memory (open_memstream) and
+// handed back to the loop, which writes them without blocking.
+//
+// Protocol: one command per line, exactly as typed at the REPL; each
+// reply ends with an empty line. A connection has at most one command in
+// flight, so replies come back in the order the commands were sent and
+// clients may pipeline freely. "exit" closes the connection; SIGINT or
+// SIGTERM stops the daemon after the queued commands have run.
+//
+//   $ printf 'grow|notes|seen|kept\nsummarize\n' | socat - UNIX-CONNECT:forenzo.sock
+
+#ifndef FORENZO_SERVE_H
+#define FORENZO_SERVE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#define SERVE_LINE_MAX  (64 * 1024)     // longest command line accepted
+#define SERVE_BACKLOG   64
+#define SERVE_EVENTS    64              // readiness events per wait
+#define SERVE_READERS   16              // reader threads at most
+
+typedef struct {
+    int  (*writes)(const char *line);   // must this command hold the write lock?
+    void (*run)(FILE *out, char *line); // runs one command, reply to out
+    void (*settle)(void);               // after each appender batch (may be NULL)
+    int readers;                        // reader threads; 0 = one per CPU
+} ServeOps;
+
+typedef struct ServeConn {
+    int fd;
+    char *in;
+    size_t in_len;
+    char *out;
+    size_t out_len, out_off, out_cap;
+    int busy;                   // a command is in flight (the conn stays allocated)
+    int eof;                    // no more input; close once idle and drained
+    int dead;                   // the client is gone; run what it sent, drop the replies
+    int skip;                   // discarding the rest of an over-long line
+    unsigned events;            // interest currently registered
+} ServeConn;
+
+typedef struct ServeJob {
+    struct ServeJob *next;
+    ServeConn *conn;
+    char *line;
+    char *reply;
+    size_t reply_len;
+} ServeJob;
+
+typedef struct {
+    ServeJob *head, *tail;
+    int closing;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+} ServeQueue;
+
+typedef struct {
+    const ServeOps *ops;
+    int listen_fd, wake[2], poll_fd;
+    ServeConn **conns;          // by fd
+    size_t nconns;
+    ServeQueue reads, writes, done;
+    pthread_rwlock_t state;
+    pthread_t appender, readers[SERVE_READERS];
+    int nreaders;
+    int stopping;               // start no new commands
+} Server;
+
+static int serve_signal_fd = -1;
+
+// ---------------------------------------------------
+// Job queues
+// ---------------------------------------------------
+static inline void serve_queue_init(ServeQueue *q) {
+    memset(q, 0, sizeof(*q));
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->ready, NULL);
+}
+
+static inline void serve_queue_destroy(ServeQueue *q) {
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->ready);
+}
+
+static inline void serve_queue_push(ServeQueue *q, ServeJob *j) {
+    j->next = NULL;
+    pthread_mutex_lock(&q->lock);
+    if (q->tail) q->tail->next = j; else q->head = j;
+    q->tail = j;
+    pthread_cond_signal(&q->ready);
+    pthread_mutex_unlock(&q->lock);
+}
+
+// Waits for work and takes one job (all of them when `all`); NULL once
+// the queue is closing and empty.
+static inline ServeJob *serve_queue_take(ServeQueue *q, int all) {
+    pthread_mutex_lock(&q->lock);
+    while (!q->head && !q->closing) pthread_cond_wait(&q->ready, &q->lock);
+    ServeJob *j = q->head;
+    if (j) {
+        q->head = all ? NULL : j->next;
+        if (!q->head) q->tail = NULL;
+        if (!all) j->next = NULL;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return j;
+}
+
+static inline ServeJob *serve_queue_drain(ServeQueue *q) {
+    pthread_mutex_lock(&q->lock);
+    ServeJob *j = q->head;
+    q->head = q->tail = NULL;
+    pthread_mutex_unlock(&q->lock);
+    return j;
+}
+
+static inline void serve_queue_close(ServeQueue *q) {
+    pthread_mutex_lock(&q->lock);
+    q->closing = 1;
+    pthread_cond_broadcast(&q->ready);
+    pthread_mutex_unlock(&q->lock);
+}
+
+// ---------------------------------------------------
+// Workers
+// ---------------------------------------------------
+static inline void serve_run(Server *s, ServeJob *j) {
+    FILE *f = open_memstream(&j->reply, &j->reply_len);
+    if (!f) { j->reply = NULL; j->reply_len = 0; return; }
+    s->ops->run(f, j->line);
+    fclose(f);
+}
+
+// Hands finished jobs back to the event loop.
+static inline void serve_finish(Server *s, ServeJob *j) {
+    while (j) {
+        ServeJob *next = j->next;
+        serve_queue_push(&s->done, j);
+        j = next;
+    }
+    char c = 0;
+    if (write(s->wake[1], &c, 1) < 0 && errno != EAGAIN) perror("serve wake");
+}
+
+static inline void *serve_reader_main(void *arg) {
+    Server *s = arg;
+    ServeJob *j;
+    while ((j = serve_queue_take(&s->reads, 0))) {
+        pthread_rwlock_rdlock(&s->state);
+        serve_run(s, j);
+        pthread_rwlock_unlock(&s->state);
+        serve_finish(s, j);
+    }
+    return NULL;
+}
+
+// The only thread that changes state: each wake-up takes every queued
+// write and runs them back to back under one write lock.
+static inline void *serve_appender_main(void *arg) {
+    Server *s = arg;
+    ServeJob *batch;
+    while ((batch = serve_queue_take(&s->writes, 1))) {
+        pthread_rwlock_wrlock(&s->state);
+        for (ServeJob *j = batch; j; j = j->next) serve_run(s, j);
+        if (s->ops->settle) s->ops->settle();
+        pthread_rwlock_unlock(&s->state);
+        serve_finish(s, batch);
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------
+// Readiness (epoll, or poll over every connection)
+// ---------------------------------------------------
+#define SERVE_IN  1u
+#define SERVE_OUT 2u
+#define SERVE_HUP 4u
+
+typedef struct { int fd; unsigned ready; } ServeEvent;
+
+// Changes fd's interest from `was` to `events`. An fd with no interest
+// leaves the epoll set, which otherwise keeps reporting hang-ups.
+static inline void serve_watch(Server *s, int fd, unsigned was, unsigned events) {
+#ifdef __linux__
+    struct epoll_event ev = { .events = (events & SERVE_IN ? EPOLLIN : 0) | (events & SERVE_OUT ? EPOLLOUT : 0),
+                              .data.fd = fd };
+    int op = !events ? EPOLL_CTL_DEL : !was ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if (epoll_ctl(s->poll_fd, op, fd, &ev) != 0) perror("epoll_ctl");
+#else
+    (void)s; (void)fd; (void)was; (void)events;     // serve_wait() asks every time
+#endif
+}
+
+static inline int serve_wait(Server *s, ServeEvent *out, int max) {
+#ifdef __linux__
+    struct epoll_event evs[SERVE_EVENTS];
+    int n = epoll_wait(s->poll_fd, evs, max < SERVE_EVENTS ? max : SERVE_EVENTS, -1);
+    for (int i = 0; i < n; i++) {
+        out[i].fd = evs[i].data.fd;
+        out[i].ready = (evs[i].events & EPOLLIN ? SERVE_IN : 0) |
+                       (evs[i].events & EPOLLOUT ? SERVE_OUT : 0) |
+                       (evs[i].events & (EPOLLHUP | EPOLLERR) ? SERVE_HUP : 0);
+    }
+    return n;
+#else
+    static struct pollfd *fds;
+    static size_t cap;
+    size_t n = 0;
+    if (cap < s->nconns + 3) {
+        struct pollfd *grown = realloc(fds, (s->nconns + 3) * sizeof(*fds));
+        if (!grown) return -1;
+        fds = grown;
+        cap = s->nconns + 3;
+    }
+    fds[n++] = (struct pollfd){ .fd = s->listen_fd, .events = POLLIN };
+    fds[n++] = (struct pollfd){ .fd = s->wake[0], .events = POLLIN };
+    fds[n++] = (struct pollfd){ .fd = serve_signal_fd, .events = POLLIN };
+    for (size_t fd = 0; fd < s->nconns; fd++) {
+        ServeConn *c = s->conns[fd];
+        if (c && c->events)
+            fds[n++] = (struct pollfd){ .fd = (int)fd, .events = (short)((c->events & SERVE_IN ? POLLIN : 0) |
+                                                                         (c->events & SERVE_OUT ? POLLOUT : 0)) };
+    }
+    int got = poll(fds, (nfds_t)n, -1);
+    if (got <= 0) return got;
+    int k = 0;
+    for (size_t i = 0; i < n && k < max; i++) {
+        if (!fds[i].revents) continue;
+        out[k].fd = fds[i].fd;
+        out[k].ready = (fds[i].revents & POLLIN ? SERVE_IN : 0) |
+                       (fds[i].revents & POLLOUT ? SERVE_OUT : 0) |
+                       (fds[i].revents & (POLLHUP | POLLERR | POLLNVAL) ? SERVE_HUP : 0);
+        k++;
+    }
+    return k;
+#endif
+}
+
+// ---------------------------------------------------
+// Connections
+// ---------------------------------------------------
+static inline void serve_close_conn(Server *s, ServeConn *c) {
+    s->conns[c->fd] = NULL;
+    close(c->fd);               // also leaves the epoll set
+    free(c->in);
+    free(c->out);
+    free(c);
+}
+
+// Registers the interest this connection needs now; read interest is
+// dropped while the input buffer is full or the client has finished.
+static inline void serve_update(Server *s, ServeConn *c) {
+    unsigned events = c->dead ? 0 : (!c->eof && c->in_len < SERVE_LINE_MAX ? SERVE_IN : 0) |
+                                    (c->out_off < c->out_len ? SERVE_OUT : 0);
+    if (events != c->events) serve_watch(s, c->fd, c->events, events);
+    c->events = events;
+}
+
+static inline int serve_reply(ServeConn *c, const char *p, size_t n) {
+    if (c->out_len + n > c->out_cap) {
+        size_t cap = c->out_cap ? c->out_cap : 4096;
+        while (cap < c->out_len + n) cap *= 2;
+        char *grown = realloc(c->out, cap);
+        if (!grown) return 0;
+        c->out = grown;
+        c->out_cap = cap;
+    }
+    memcpy(c->out + c->out_len, p, n);
+    c->out_len += n;
+    return 1;
+}
+
+// Sends what it can; 0 when the connection is gone.
+static inline int serve_flush(ServeConn *c) {
+    while (c->out_off < c->out_len) {
+        ssize_t w = send(c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        c->out_off += (size_t)w;
+    }
+    c->out_off = c->out_len = 0;
+    return 1;
+}
+
+// Starts the next buffered command when none is in flight and sends
+// what is pending. Returns 0 when the connection should be closed,
+// which is never while a command is in flight.
+static inline int serve_next(Server *s, ServeConn *c) {
+    while (!c->busy && !s->stopping) {
+        char *nl = memchr(c->in, '\n', c->in_len);
+        if (!nl) {
+            if (c->in_len >= SERVE_LINE_MAX) {
+                if (!c->skip) serve_reply(c, "Line too long.\n\n", 16);
+                c->skip = 1;
+                c->in_len = 0;
+            }
+            break;
+        }
+        size_t n = (size_t)(nl - c->in), L = n;
+        if (c->skip) {
+            memmove(c->in, nl + 1, c->in_len - n - 1);
+            c->in_len -= n + 1;
+            c->skip = 0;
+            continue;
+        }
+        while (L && (c->in[L-1] == '\r')) L--;
+        char *line = NULL;
+        int quit = L == 4 && memcmp(c->in, "exit", 4) == 0;
+        if (L && !quit && (line = malloc(L + 1))) {
+            memcpy(line, c->in, L);
+            line[L] = '\0';
+        }
+        memmove(c->in, nl + 1, c->in_len - n - 1);
+        c->in_len -= n + 1;
+        if (quit) {
+            serve_reply(c, "Goodbye.\n\n", 10);
+            c->eof = 1;
+            c->in_len = 0;
+            break;
+        }
+        if (!L) continue;
+        ServeJob *j = line ? calloc(1, sizeof(*j)) : NULL;
+        if (!j) {
+            free(line);
+            serve_reply(c, "Out of memory.\n\n", 16);
+            continue;
+        }
+        j->conn = c;
+        j->line = line;
+        c->busy = 1;
+        serve_queue_push(s->ops->writes(line) ? &s->writes : &s->reads, j);
+    }
+    if (!c->dead && !serve_flush(c)) c->dead = 1;
+    if (c->dead) c->out_off = c->out_len = 0;
+    serve_update(s, c);
+    return c->busy || (!c->dead && (!c->eof || c->out_len));
+}
+
+static inline void serve_readable(Server *s, ServeConn *c, int hup) {
+    for (;;) {
+        size_t room = SERVE_LINE_MAX - c->in_len;
+        if (!room) {
+            if (hup) c->eof = c->dead = 1;    // hung up with input we cannot take yet
+            break;
+        }
+        ssize_t r = recv(c->fd, c->in + c->in_len, room, 0);
+        if (r > 0) { c->in_len += (size_t)r; continue; }
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        c->eof = 1;
+        if (r < 0) c->dead = 1;
+        break;
+    }
+    if (!serve_next(s, c)) serve_close_conn(s, c);
+}
+
+static inline void serve_accept(Server *s) {
+    for (;;) {
+        int fd = accept(s->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept");
+            return;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        if ((size_t)fd >= s->nconns) {
+            size_t n = s->nconns ? s->nconns : 64;
+            while (n <= (size_t)fd) n *= 2;
+            ServeConn **grown = realloc(s->conns, n * sizeof(*grown));
+            if (!grown) { close(fd); continue; }
+            memset(grown + s->nconns, 0, (n - s->nconns) * sizeof(*grown));
+            s->conns = grown;
+            s->nconns = n;
+        }
+        ServeConn *c = calloc(1, sizeof(*c));
+        if (!c || !(c->in = malloc(SERVE_LINE_MAX))) { free(c); close(fd); continue; }
+        c->fd = fd;
+        c->events = SERVE_IN;
+        s->conns[fd] = c;
+        serve_watch(s, fd, 0, SERVE_IN);
+    }
+}
+
+// Replies from the workers: queue them for sending, then move on to
+// each connection's next command.
+static inline void serve_completed(Server *s) {
+    char drain[256];
+    while (read(s->wake[0], drain, sizeof(drain)) > 0) {}
+    for (ServeJob *j = serve_queue_drain(&s->done), *next; j; j = next) {
+        next = j->next;
+        ServeConn *c = j->conn;
+        int ok = j->reply ? serve_reply(c, j->reply, j->reply_len) : 0;
+        if (!ok) serve_reply(c, "Out of memory.\n", 15);
+        else if (j->reply_len && j->reply[j->reply_len - 1] != '\n') serve_reply(c, "\n", 1);
+        serve_reply(c, "\n", 1);
+        c->busy = 0;
+        free(j->reply);
+        free(j->line);
+        free(j);
+        if (!serve_next(s, c)) serve_close_conn(s, c);
+    }
+}
+
+// ---------------------------------------------------
+// Setup / Teardown
+// ---------------------------------------------------
+static void serve_on_signal(int sig) {
+    char c = (char)sig;
+    if (write(serve_signal_fd, &c, 1) < 0) {}
+}
+
+static inline int serve_listen(const char *path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) { perror("socket"); return -1; }
+    // A socket file nobody answers on is left over from an earlier run.
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        fprintf(stderr, "Another Forenzo is already serving on %s.\n", path);
+        close(fd);
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SERVE_BACKLOG) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+static inline int serve_pipe(int p[2]) {
+    if (pipe(p) != 0) return 0;
+    for (int i = 0; i < 2; i++) {
+        fcntl(p[i], F_SETFL, fcntl(p[i], F_GETFL) | O_NONBLOCK);
+        fcntl(p[i], F_SETFD, FD_CLOEXEC);
+    }
+    return 1;
+}
+
+// Serves until SIGINT or SIGTERM; returns 0 on a clean stop.
+static inline int serve(const char *path, const ServeOps *ops) {
+    Server s = { .ops = ops, .poll_fd = -1 };
+    int sig[2];
+    s.listen_fd = serve_listen(path);
+    if (s.listen_fd < 0) return 1;
+    if (!serve_pipe(s.wake) || !serve_pipe(sig)) {
+        perror("pipe");
+        close(s.listen_fd);
+        unlink(path);
+        return 1;
+    }
+    serve_signal_fd = sig[1];
+    struct sigaction sa = { .sa_handler = serve_on_signal }, old_int, old_term, old_pipe;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, &old_int);
+    sigaction(SIGTERM, &sa, &old_term);
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, &old_pipe);
+
+#ifdef __linux__
+    s.poll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (s.poll_fd < 0) { perror("epoll_create1"); return 1; }
+#endif
+    serve_watch(&s, s.listen_fd, 0, SERVE_IN);
+    serve_watch(&s, s.wake[0], 0, SERVE_IN);
+    serve_watch(&s, sig[0], 0, SERVE_IN);
+
+    serve_queue_init(&s.reads);
+    serve_queue_init(&s.writes);
+    serve_queue_init(&s.done);
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+    // a steady stream of reads must not starve the appender
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+    pthread_rwlock_init(&s.state, &attr);
+    pthread_rwlockattr_destroy(&attr);
+
+    int want = ops->readers > 0 ? ops->readers : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (want < 1) want = 1;
+    if (want > SERVE_READERS) want = SERVE_READERS;
+    int ok = pthread_create(&s.appender, NULL, serve_appender_main, &s) == 0;
+    for (; ok && s.nreaders < want; s.nreaders++)
+        if (pthread_create(&s.readers[s.nreaders], NULL, serve_reader_main, &s) != 0) break;
+    if (!ok || s.nreaders == 0) fprintf(stderr, "Cannot start the serving threads.\n");
+
+    for (int stop = !ok || s.nreaders == 0; !stop;) {
+        ServeEvent evs[SERVE_EVENTS];
+        int n = serve_wait(&s, evs, SERVE_EVENTS);
+        if (n < 0 && errno != EINTR) { perror("serve wait"); break; }
+        for (int i = 0; i < n; i++) {
+            int fd = evs[i].fd;
+            if (fd == s.listen_fd) serve_accept(&s);
+            else if (fd == s.wake[0]) serve_completed(&s);
+            else if (fd == sig[0]) stop = 1;
+            else if ((size_t)fd < s.nconns && s.conns[fd]) {
+                ServeConn *c = s.conns[fd];
+                if (evs[i].ready & (SERVE_IN | SERVE_HUP)) serve_readable(&s, c, evs[i].ready & SERVE_HUP);
+                else if (!serve_next(&s, c)) serve_close_conn(&s, c);
+            }
+        }
+    }
+
+    // Let every queued command run before the state is closed.
+    s.stopping = 1;
+    serve_queue_close(&s.writes);
+    serve_queue_close(&s.reads);
+    if (ok) pthread_join(s.appender, NULL);
+    for (int i = 0; i < s.nreaders; i++) pthread_join(s.readers[i], NULL);
+    serve_completed(&s);
+    for (size_t fd = 0; fd < s.nconns; fd++)
+        if (s.conns[fd]) serve_close_conn(&s, s.conns[fd]);
+    free(s.conns);
+
+    sigaction(SIGINT, &old_int, NULL);
+    sigaction(SIGTERM, &old_term, NULL);
+    sigaction(SIGPIPE, &old_pipe, NULL);
+    serve_signal_fd = -1;
+    close(sig[0]); close(sig[1]);
+    close(s.wake[0]); close(s.wake[1]);
+    if (s.poll_fd >= 0) close(s.poll_fd);
+    close(s.listen_fd);
+    unlink(path);
+    pthread_rwlock_destroy(&s.state);
+    serve_queue_destroy(&s.reads);
+    serve_queue_destroy(&s.writes);
+    serve_queue_destroy(&s.done);
+    return ok && s.nreaders ? 0 : 1;
+}
+
+#endif // FORENZO_SERVE_H
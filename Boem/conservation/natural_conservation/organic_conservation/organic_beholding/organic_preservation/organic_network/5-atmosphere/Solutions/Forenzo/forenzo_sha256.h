@@ -0,0 +1,250 @@
+// forenzo_sha256.h — self-contained SHA-256 (FIPS 180-4)
+// No OpenSSL: uses the SHA extensions when the CPU has them (x86 SHA-NI,
+// picked at run time; ARMv8 crypto, picked at compile time, which
+// includes every Apple Silicon Mac) and portable C otherwise.
+// Incremental: init / update… / final, or sha256() for one buffer;
+// hmac_sha256() on top.
+
+#ifndef FORENZO_SHA256_H
+#define FORENZO_SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA256_X86 1
+#elif defined(__aarch64__) && (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+#include <arm_neon.h>
+#define SHA256_ARM 1
+#endif
+
+typedef struct {
+    uint32_t h[8];
+    uint64_t len;           // bytes hashed so far
+    unsigned char buf[64];
+    size_t nbuf;
+} Sha256;
+
+static const uint32_t sha256_k[64] __attribute__((aligned(16))) = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+// ---------------------------------------------------
+// Portable compression function
+// ---------------------------------------------------
+#define SHA256_ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static inline void sha256_blocks_c(uint32_t h[8], const unsigned char *p, size_t blocks) {
+    while (blocks--) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++)
+            w[i] = (uint32_t)p[4*i] << 24 | (uint32_t)p[4*i+1] << 16 | (uint32_t)p[4*i+2] << 8 | p[4*i+3];
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = SHA256_ROR(w[i-15], 7) ^ SHA256_ROR(w[i-15], 18) ^ (w[i-15] >> 3);
+            uint32_t s1 = SHA256_ROR(w[i-2], 17) ^ SHA256_ROR(w[i-2], 19) ^ (w[i-2] >> 10);
+            w[i] = w[i-16] + s0 + w[i-7] + s1;
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t t1 = hh + (SHA256_ROR(e, 6) ^ SHA256_ROR(e, 11) ^ SHA256_ROR(e, 25)) +
+                          ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+            uint32_t t2 = (SHA256_ROR(a, 2) ^ SHA256_ROR(a, 13) ^ SHA256_ROR(a, 22)) +
+                          ((a & b) ^ (a & c) ^ (b & c));
+            hh = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+        h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+        p += 64;
+    }
+}
+
+// ---------------------------------------------------
+// x86 SHA-NI
+// ---------------------------------------------------
+#ifdef SHA256_X86
+__attribute__((target("sha,sse4.1")))
+static inline void sha256_blocks_shani(uint32_t h[8], const unsigned char *p, size_t blocks) {
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bll, 0x0405060700010203ll);
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&h[0]), 0xB1);   // CDAB
+    __m128i st1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&h[4]), 0x1B);   // EFGH
+    __m128i st0 = _mm_alignr_epi8(tmp, st1, 8);                                        // ABEF
+    st1 = _mm_blend_epi16(st1, tmp, 0xF0);                                             // CDGH
+
+    while (blocks--) {
+        __m128i abef = st0, cdgh = st1, m[4];
+        for (int i = 0; i < 4; i++)
+            m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 16 * i)), bswap);
+        for (int i = 0; i < 16; i++) {
+            __m128i msg = _mm_add_epi32(m[i & 3], _mm_load_si128((const __m128i *)&sha256_k[4 * i]));
+            st1 = _mm_sha256rnds2_epu32(st1, st0, msg);
+            if (i >= 3 && i <= 14) {
+                __m128i t = _mm_alignr_epi8(m[i & 3], m[(i - 1) & 3], 4);
+                m[(i + 1) & 3] = _mm_sha256msg2_epu32(_mm_add_epi32(m[(i + 1) & 3], t), m[i & 3]);
+            }
+            st0 = _mm_sha256rnds2_epu32(st0, st1, _mm_shuffle_epi32(msg, 0x0E));
+            if (i >= 1 && i <= 12) m[(i - 1) & 3] = _mm_sha256msg1_epu32(m[(i - 1) & 3], m[i & 3]);
+        }
+        st0 = _mm_add_epi32(st0, abef);
+        st1 = _mm_add_epi32(st1, cdgh);
+        p += 64;
+    }
+
+    tmp = _mm_shuffle_epi32(st0, 0x1B);                                                // FEBA
+    st1 = _mm_shuffle_epi32(st1, 0xB1);                                                // DCHG
+    _mm_storeu_si128((__m128i *)&h[0], _mm_blend_epi16(tmp, st1, 0xF0));               // DCBA
+    _mm_storeu_si128((__m128i *)&h[4], _mm_alignr_epi8(st1, tmp, 8));                  // HGFE
+}
+
+static inline int sha256_have_shani(void) {
+    unsigned a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & (1u << 19))) return 0;              // SSE4.1
+    return __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & (1u << 29));               // SHA
+}
+#endif
+
+// ---------------------------------------------------
+// ARMv8 crypto extensions
+// ---------------------------------------------------
+#ifdef SHA256_ARM
+static inline void sha256_blocks_arm(uint32_t h[8], const unsigned char *p, size_t blocks) {
+    uint32x4_t st0 = vld1q_u32(&h[0]), st1 = vld1q_u32(&h[4]);
+    while (blocks--) {
+        uint32x4_t abcd = st0, efgh = st1, m[4];
+        for (int i = 0; i < 4; i++) m[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p + 16 * i)));
+        for (int i = 0; i < 16; i++) {
+            uint32x4_t wk = vaddq_u32(m[i & 3], vld1q_u32(&sha256_k[4 * i]));
+            if (i < 12)
+                m[i & 3] = vsha256su1q_u32(vsha256su0q_u32(m[i & 3], m[(i + 1) & 3]),
+                                           m[(i + 2) & 3], m[(i + 3) & 3]);
+            uint32x4_t a = st0;
+            st0 = vsha256hq_u32(st0, st1, wk);
+            st1 = vsha256h2q_u32(st1, a, wk);
+        }
+        st0 = vaddq_u32(st0, abcd);
+        st1 = vaddq_u32(st1, efgh);
+        p += 64;
+    }
+    vst1q_u32(&h[0], st0);
+    vst1q_u32(&h[4], st1);
+}
+#endif
+
+// ---------------------------------------------------
+// Dispatch
+// ---------------------------------------------------
+static void (*sha256_blocks)(uint32_t *, const unsigned char *, size_t);
+
+// Name of the implementation in use ("sha-ni", "armv8" or "portable").
+static inline const char *sha256_impl(void) {
+    if (!sha256_blocks) {
+        sha256_blocks = sha256_blocks_c;
+#if defined(SHA256_X86)
+        if (sha256_have_shani()) sha256_blocks = sha256_blocks_shani;
+#elif defined(SHA256_ARM)
+        sha256_blocks = sha256_blocks_arm;
+#endif
+    }
+#if defined(SHA256_X86)
+    if (sha256_blocks == sha256_blocks_shani) return "sha-ni";
+#elif defined(SHA256_ARM)
+    if (sha256_blocks == sha256_blocks_arm) return "armv8";
+#endif
+    return "portable";
+}
+
+// ---------------------------------------------------
+// Streaming interface
+// ---------------------------------------------------
+static inline void sha256_init(Sha256 *s) {
+    static const uint32_t iv[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    if (!sha256_blocks) sha256_impl();
+    memcpy(s->h, iv, sizeof(iv));
+    s->len = 0;
+    s->nbuf = 0;
+}
+
+static inline void sha256_update(Sha256 *s, const void *data, size_t n) {
+    const unsigned char *p = data;
+    s->len += n;
+    if (s->nbuf) {
+        size_t take = 64 - s->nbuf < n ? 64 - s->nbuf : n;
+        memcpy(s->buf + s->nbuf, p, take);
+        s->nbuf += take;
+        p += take;
+        n -= take;
+        if (s->nbuf < 64) return;
+        sha256_blocks(s->h, s->buf, 1);
+        s->nbuf = 0;
+    }
+    if (n >= 64) {
+        sha256_blocks(s->h, p, n / 64);
+        p += n & ~(size_t)63;
+        n &= 63;
+    }
+    memcpy(s->buf, p, n);
+    s->nbuf = n;
+}
+
+static inline void sha256_final(Sha256 *s, unsigned char out[32]) {
+    uint64_t bits = s->len * 8;
+    unsigned char pad[72] = { 0x80 };
+    size_t padn = (s->nbuf < 56 ? 56 : 120) - s->nbuf;
+    for (int i = 0; i < 8; i++) pad[padn + i] = (unsigned char)(bits >> (56 - 8 * i));
+    sha256_update(s, pad, padn + 8);
+    for (int i = 0; i < 8; i++) {
+        out[4*i]     = (unsigned char)(s->h[i] >> 24);
+        out[4*i + 1] = (unsigned char)(s->h[i] >> 16);
+        out[4*i + 2] = (unsigned char)(s->h[i] >> 8);
+        out[4*i + 3] = (unsigned char)s->h[i];
+    }
+}
+
+static inline void sha256(const void *data, size_t n, unsigned char out[32]) {
+    Sha256 s;
+    sha256_init(&s);
+    sha256_update(&s, data, n);
+    sha256_final(&s, out);
+}
+
+// HMAC-SHA256 (RFC 2104).
+static inline void hmac_sha256(const void *key, size_t key_n, const void *msg, size_t n, unsigned char out[32]) {
+    unsigned char k[64] = {0}, pad[64];
+    if (key_n > 64) sha256(key, key_n, k);
+    else memcpy(k, key, key_n);
+    Sha256 s;
+    for (int i = 0; i < 64; i++) pad[i] = k[i] ^ 0x36;
+    sha256_init(&s);
+    sha256_update(&s, pad, 64);
+    sha256_update(&s, msg, n);
+    sha256_final(&s, out);
+    for (int i = 0; i < 64; i++) pad[i] = k[i] ^ 0x5c;
+    sha256_init(&s);
+    sha256_update(&s, pad, 64);
+    sha256_update(&s, out, 32);
+    sha256_final(&s, out);
+}
+
+// 64 lowercase hex digits plus NUL.
+static inline void sha256_hex(const unsigned char h[32], char out[65]) {
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < 32; i++) {
+        out[2*i] = digits[h[i] >> 4];
+        out[2*i + 1] = digits[h[i] & 15];
+    }
+    out[64] = '\0';
+}
+
+#endif // FORENZO_SHA256_H
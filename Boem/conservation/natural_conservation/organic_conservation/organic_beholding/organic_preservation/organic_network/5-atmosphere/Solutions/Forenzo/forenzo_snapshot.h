@@ -0,0 +1,214 @@
+// forenzo_snapshot.h — binary checkpoints of in-memory index state
+// A snapshot holds the indexes as they stood after the first `records`
+// entries, so start-up loads it in bulk and replays only sidecar records
+// from `records` on, instead of the whole history.
+//
+// Layout, all fields little-endian:
+//   "FZSN"  u32 version  u64 records
+//   sections: u32 tag, u64 length, payload
+//   u32 tag 0, u32 CRC-32 of every byte before it
+// Written to <path>.tmp, fsynced and renamed, so a reader sees either
+// the previous snapshot or the new one, never a partial file.
+//
+// snap_spawn() takes the snapshot in a forked child: the copy-on-write
+// image is a consistent view of memory while the parent keeps appending.
+// Child code must stick to write()/close() (no malloc, no stdio), since
+// other threads may have held their locks at fork time.
+
+#ifndef FORENZO_SNAPSHOT_H
+#define FORENZO_SNAPSHOT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "forenzo_endian.h"
+#include "forenzo_crc32.h"
+
+#define SNAP_MAGIC   "FZSN"
+#define SNAP_VERSION 1
+
+typedef struct {
+    int fd;
+    uint32_t crc;
+    int ok;
+    unsigned char buf[64 * 1024];
+    size_t len;
+    char path[1024], tmp[1040];
+} SnapWriter;
+
+// ---------------------------------------------------
+// Writing
+// ---------------------------------------------------
+static inline void snap_flush(SnapWriter *w) {
+    for (size_t off = 0; w->ok && off < w->len;) {
+        ssize_t n = write(w->fd, w->buf + off, w->len - off);
+        if (n <= 0) w->ok = 0;
+        else off += (size_t)n;
+    }
+    w->len = 0;
+}
+
+static inline void snap_write(SnapWriter *w, const void *data, size_t n) {
+    const unsigned char *p = data;
+    w->crc = crc32_update(w->crc, p, n);
+    while (n) {
+        if (w->len == sizeof(w->buf)) snap_flush(w);
+        size_t take = sizeof(w->buf) - w->len < n ? sizeof(w->buf) - w->len : n;
+        memcpy(w->buf + w->len, p, take);
+        w->len += take;
+        p += take;
+        n -= take;
+    }
+}
+
+static inline void snap_u32(SnapWriter *w, uint32_t v) {
+    unsigned char b[4]; put_le32(b, v); snap_write(w, b, 4);
+}
+
+static inline void snap_u64(SnapWriter *w, uint64_t v) {
+    unsigned char b[8]; put_le64(b, v); snap_write(w, b, 8);
+}
+
+static inline void snap_section(SnapWriter *w, uint32_t tag, uint64_t len) {
+    snap_u32(w, tag);
+    snap_u64(w, len);
+}
+
+static inline int snap_begin(SnapWriter *w, const char *path, uint64_t records) {
+    snprintf(w->path, sizeof(w->path), "%s", path);
+    snprintf(w->tmp, sizeof(w->tmp), "%s.tmp", path);
+    w->fd = open(w->tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    w->crc = 0;
+    w->len = 0;
+    w->ok = w->fd >= 0;
+    if (!w->ok) return 0;
+    snap_write(w, SNAP_MAGIC, 4);
+    snap_u32(w, SNAP_VERSION);
+    snap_u64(w, records);
+    return 1;
+}
+
+// Seal and publish; returns 0 (and leaves the old snapshot) on failure.
+static inline int snap_commit(SnapWriter *w) {
+    if (w->fd < 0) return 0;
+    snap_u32(w, 0);
+    unsigned char b[4]; put_le32(b, w->crc);
+    snap_write(w, b, 4);
+    snap_flush(w);
+    if (w->ok && fsync(w->fd) != 0) w->ok = 0;
+    close(w->fd);
+    w->fd = -1;
+    if (w->ok && rename(w->tmp, w->path) != 0) w->ok = 0;
+    if (!w->ok) unlink(w->tmp);
+    return w->ok;
+}
+
+// ---------------------------------------------------
+// Reading
+// ---------------------------------------------------
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    uint64_t records;
+} Snapshot;
+
+static inline void snap_free(Snapshot *s) {
+    if (s->data) munmap(s->data, s->len);
+    memset(s, 0, sizeof(*s));
+}
+
+// Maps and checks the whole file; returns 0 when absent or damaged.
+// Sections may be used in place until snap_free (the mapping outlives a
+// newer snapshot renamed over the file).
+static inline int snap_load(Snapshot *s, const char *path) {
+    memset(s, 0, sizeof(*s));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= 24)
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+    s->data = map;
+    s->len = (size_t)st.st_size;
+    if (memcmp(s->data, SNAP_MAGIC, 4) != 0 ||
+        get_le32(s->data + 4) != SNAP_VERSION ||
+        get_le32(s->data + s->len - 8) != 0 ||
+        get_le32(s->data + s->len - 4) != crc32_update(0, s->data, s->len - 4)) {
+        fprintf(stderr, "%s: damaged snapshot ignored\n", path);
+        snap_free(s);
+        return 0;
+    }
+    s->records = get_le64(s->data + 8);
+    return 1;
+}
+
+// Payload of section `tag`, or NULL.
+static inline const unsigned char *snap_find(const Snapshot *s, uint32_t tag, uint64_t *len) {
+    size_t at = 16;
+    while (at + 12 <= s->len - 8) {
+        uint32_t t = get_le32(s->data + at);
+        uint64_t n = get_le64(s->data + at + 4);
+        if (n > s->len - 8 - at - 12) return NULL;
+        if (t == tag) { *len = n; return s->data + at + 12; }
+        at += 12 + (size_t)n;
+    }
+    return NULL;
+}
+
+
+// ---------------------------------------------------
+// Background snapshots and sidecar compaction
+// ---------------------------------------------------
+// Runs write(ctx) in a forked child; returns its pid, or -1 when it ran
+// here instead (fork failed).
+static inline pid_t snap_spawn(int (*write_fn)(void *), void *ctx) {
+    pid_t pid = fork();
+    if (pid == 0) _exit(write_fn(ctx) ? 0 : 1);
+    if (pid < 0) write_fn(ctx);
+    return pid < 0 ? -1 : pid;
+}
+
+// Collects a finished child; with block = 0 returns 0 while it still runs.
+static inline int snap_reap(pid_t *pid, int block) {
+    if (*pid <= 0) return 1;
+    int status;
+    pid_t r = waitpid(*pid, &status, block ? 0 : WNOHANG);
+    if (r == 0) return 0;
+    if (r < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) fprintf(stderr, "snapshot failed\n");
+    *pid = 0;
+    return 1;
+}
+
+// Drop the first `prefix` bytes of a sidecar whose records a snapshot
+// already holds. Only worth it once they outweigh the live tail. The
+// sidecar is replaced, so its writer must be closed first: the indexes
+// call this from their close, keeping the copy out of start-up.
+static inline void snap_drop_prefix(const char *path, off_t prefix) {
+    struct stat st;
+    if (prefix <= 0 || stat(path, &st) != 0 || prefix > st.st_size || prefix < st.st_size - prefix) return;
+    off_t size = st.st_size;
+    char tmp[1040];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int in = open(path, O_RDONLY), out = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int ok = in >= 0 && out >= 0;
+    char buf[64 * 1024];
+    for (off_t at = prefix; ok && at < size;) {
+        ssize_t n = pread(in, buf, sizeof(buf), at);
+        ok = n > 0 && write(out, buf, (size_t)n) == n;
+        at += n > 0 ? n : 0;
+    }
+    if (ok) ok = fsync(out) == 0;
+    if (in >= 0) close(in);
+    if (out >= 0) close(out);
+    if (!ok || rename(tmp, path) != 0) { unlink(tmp); perror("compact sidecar"); }
+}
+
+#endif // FORENZO_SNAPSHOT_H
@@ -0,0 +1,220 @@
+// forenzo_store.h — memory-mapped, growable MemoryToken store (forenzo.bin)
+//
+// Layout, all fields little-endian:
+//   0  "FZTK"           magic
+//   4  u32 version      STORE_VERSION
+//   8  u32 token_size   16
+//  12  u32 header_crc   CRC-32 of the 64-byte header with this field zeroed
+//  16  u64 count        tokens in use
+//  24  u64 capacity     tokens the file has room for
+//  32  u32 data_crc     CRC-32 of the count*16 token bytes (kept incrementally)
+//  36  reserved (zero) up to 64
+//  64  MemoryToken[capacity]
+//
+// A headerless forenzo.bin (raw tokens with a 16-bit id and 32-bit flags)
+// is migrated to this layout when opened.
+//
+// Opening only checks the header, so start-up cost does not depend on the
+// number of tokens; tokens are used in place through the mapping. Capacity
+// doubles when full, so appends are amortized O(1).
+
+#ifndef FORENZO_STORE_H
+#define FORENZO_STORE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "forenzo_endian.h"
+#include "forenzo_crc32.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "forenzo.bin tokens are mapped in place and stored little-endian"
+#endif
+
+// Memory token: 16 bytes
+typedef struct {
+    uint32_t id;            // position + 1
+    uint16_t collection;
+    uint16_t flags;
+    uint32_t observation;
+    uint32_t solution;
+} MemoryToken;
+
+_Static_assert(sizeof(MemoryToken) == 16, "MemoryToken must stay 16 bytes");
+
+// Token flag: fields are dictionary ids (older tokens hold ×31 hashes)
+#define TOKEN_INTERNED 0x1
+
+#define STORE_MAGIC        "FZTK"
+#define STORE_VERSION      2
+#define STORE_HEADER_SIZE  64
+#define STORE_MIN_CAPACITY 1024
+
+typedef struct {
+    int fd;
+    unsigned char *map;     // header + tokens
+    size_t map_size;
+    MemoryToken *tokens;    // points into map, valid until the next append
+    uint64_t count, capacity;
+    uint32_t data_crc;
+} TokenStore;
+
+// ---------------------------------------------------
+// Header
+// ---------------------------------------------------
+static uint32_t store_header_crc(const unsigned char *h) {
+    unsigned char copy[STORE_HEADER_SIZE];
+    memcpy(copy, h, sizeof(copy));
+    put_le32(copy + 12, 0);
+    return crc32_update(0, copy, sizeof(copy));
+}
+
+static void store_write_header(TokenStore *s) {
+    unsigned char *h = s->map;
+    memcpy(h, STORE_MAGIC, 4);
+    put_le32(h + 4, STORE_VERSION);
+    put_le32(h + 8, sizeof(MemoryToken));
+    put_le64(h + 16, s->count);
+    put_le64(h + 24, s->capacity);
+    put_le32(h + 32, s->data_crc);
+    put_le32(h + 12, store_header_crc(h));
+}
+
+static int store_map(TokenStore *s, uint64_t capacity) {
+    size_t size = STORE_HEADER_SIZE + (size_t)capacity * sizeof(MemoryToken);
+    if (s->map) munmap(s->map, s->map_size);
+    s->map = NULL;
+    s->tokens = NULL;
+    if (ftruncate(s->fd, (off_t)size) != 0) { perror("grow memory file"); return 0; }
+    void *m = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, s->fd, 0);
+    if (m == MAP_FAILED) { perror("map memory file"); return 0; }
+    s->map = m;
+    s->map_size = size;
+    s->capacity = capacity;
+    s->tokens = (MemoryToken *)(s->map + STORE_HEADER_SIZE);
+    return 1;
+}
+
+// ---------------------------------------------------
+// Legacy layout
+// ---------------------------------------------------
+// Headerless tokens: u16 id, u16 collection, u32 observation, u32
+// solution, u32 flags. Ids are renumbered from the position, since the
+// old ones wrapped at 65536.
+static uint32_t store_upgrade_tokens(MemoryToken *tokens, uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+        const unsigned char *b = (const unsigned char *)&tokens[i];
+        MemoryToken t;
+        t.id = (uint32_t)(i + 1);
+        t.collection = get_le16(b + 2);
+        t.observation = get_le32(b + 4);
+        t.solution = get_le32(b + 8);
+        t.flags = (uint16_t)get_le32(b + 12);
+        tokens[i] = t;
+    }
+    return crc32_update(0, tokens, (size_t)n * sizeof(MemoryToken));
+}
+
+// Legacy forenzo.bin: raw 16-byte tokens with no header
+static int store_migrate_legacy(const char *path, int fd, off_t size) {
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.migrate", path);
+    TokenStore t = { .fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644) };
+    if (t.fd < 0) { perror("migrate memory file"); return 0; }
+    uint64_t n = (uint64_t)size / sizeof(MemoryToken), cap = STORE_MIN_CAPACITY;
+    while (cap < n) cap *= 2;
+    if (!store_map(&t, cap)) { close(t.fd); return 0; }
+    if (pread(fd, t.tokens, (size_t)n * sizeof(MemoryToken), 0) != (ssize_t)(n * sizeof(MemoryToken))) {
+        perror("read legacy memory file");
+        munmap(t.map, t.map_size); close(t.fd);
+        return 0;
+    }
+    t.count = n;
+    t.data_crc = store_upgrade_tokens(t.tokens, n);
+    store_write_header(&t);
+    msync(t.map, t.map_size, MS_SYNC);
+    munmap(t.map, t.map_size);
+    close(t.fd);
+    if (rename(tmp, path) != 0) { perror("replace memory file"); return 0; }
+    printf("Migrated %llu legacy memory tokens to %s v%d.\n",
+           (unsigned long long)n, STORE_MAGIC, STORE_VERSION);
+    return 1;
+}
+
+// ---------------------------------------------------
+// Open / Close
+// ---------------------------------------------------
+static int token_store_open(TokenStore *s, const char *path) {
+    memset(s, 0, sizeof(*s));
+    s->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (s->fd < 0) { perror("open memory file"); return 0; }
+    struct stat st;
+    fstat(s->fd, &st);
+
+    unsigned char h[STORE_HEADER_SIZE] = {0};
+    if (st.st_size > 0 &&
+        (pread(s->fd, h, sizeof(h), 0) < 4 || memcmp(h, STORE_MAGIC, 4) != 0)) {
+        if (st.st_size % sizeof(MemoryToken) != 0) {
+            fprintf(stderr, "%s: not a Forenzo memory file\n", path);
+            return 0;
+        }
+        if (!store_migrate_legacy(path, s->fd, st.st_size)) return 0;
+        close(s->fd);
+        return token_store_open(s, path);
+    }
+
+    if (st.st_size == 0) {
+        if (!store_map(s, STORE_MIN_CAPACITY)) return 0;
+        store_write_header(s);
+        return 1;
+    }
+
+    uint32_t version = get_le32(h + 4);
+    if (version != STORE_VERSION || get_le32(h + 8) != sizeof(MemoryToken) ||
+        get_le32(h + 12) != store_header_crc(h)) {
+        fprintf(stderr, "%s: unsupported or corrupt header\n", path);
+        return 0;
+    }
+    uint64_t capacity = get_le64(h + 24);
+    if (get_le64(h + 16) > capacity ||
+        (uint64_t)st.st_size < STORE_HEADER_SIZE + capacity * sizeof(MemoryToken)) {
+        fprintf(stderr, "%s: truncated (capacity %llu)\n", path, (unsigned long long)capacity);
+        return 0;
+    }
+    if (!store_map(s, capacity)) return 0;
+    s->count = get_le64(h + 16);
+    s->data_crc = get_le32(h + 32);
+    return 1;
+}
+
+static void token_store_close(TokenStore *s) {
+    if (s->map) {
+        msync(s->map, s->map_size, MS_SYNC);
+        munmap(s->map, s->map_size);
+    }
+    if (s->fd >= 0) close(s->fd);
+    s->map = NULL;
+    s->tokens = NULL;
+    s->fd = -1;
+}
+
+// ---------------------------------------------------
+// Append
+// ---------------------------------------------------
+// Returns the new token's index, or -1. Invalidates earlier token pointers.
+static int64_t token_store_append(TokenStore *s, const MemoryToken *t) {
+    if (!s->map) return -1;
+    if (s->count == s->capacity && !store_map(s, s->capacity * 2)) return -1;
+    s->tokens[s->count] = *t;
+    s->data_crc = crc32_update(s->data_crc, t, sizeof(*t));
+    s->count++;
+    store_write_header(s);
+    return (int64_t)s->count - 1;
+}
+
+#endif // FORENZO_STORE_H
@@ -0,0 +1,930 @@
+// forenzo_sync.h — incremental, content-addressed sync with a backup directory
+// Files are cut into content-defined chunks (a FastCDC-style gear hash:
+// 2 KiB minimum, about 8 KiB on average, 64 KiB maximum), so an append or
+// an edit only changes the chunks around it. Each chunk is stored once in
+// the target, named by its SHA-256 and LZ-compressed when that is smaller,
+// and a file is a manifest listing its chunks. Pushing writes only chunks
+// the target lacks; pulling reads only chunks the local file lacks.
+//
+//   <dir>/chunks/ab/cdef…   one chunk: u8 codec, u32 LE raw length, payload
+//   <dir>/<name>.fzm        the file's manifest
+//   <file>.sync             local cache: <file>'s manifest and stat
+//                           identity, plus the version it last synced with
+//
+// Manifest (.fzm and .sync), little-endian:
+//    0 "FZSM", u32 version, u64 size, u64 dev, u64 ino, i64 mtime_ns,
+//   40 base[32], u32 count, count x (hash[32], u32 length), u32 crc32
+// Target manifests leave the identity and base zero.
+//
+// The cache lets a file that only grew be rescanned from its last chunk
+// (the only one cut by end of file rather than by content), after that
+// chunk re-hashes to the same value: a log append costs what was appended.
+
+#ifndef FORENZO_SYNC_H
+#define FORENZO_SYNC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include "forenzo_endian.h"
+#include "forenzo_crc32.h"
+#include "forenzo_sha256.h"
+#include "forenzo_lz.h"
+#include "forenzo_intern.h"     // line sets for merges
+
+#define SYNC_MAGIC     "FZSM"
+#define SYNC_VERSION   1
+#define SYNC_HEADER    76
+#define SYNC_ENTRY     36
+#define SYNC_MIN_CHUNK (2 * 1024)
+#define SYNC_AVG_CHUNK (8 * 1024)
+#define SYNC_MAX_CHUNK (64 * 1024)
+#define SYNC_MASK_S    0x0003590703530000ull   // 15 bits: cuts rarely before the average
+#define SYNC_MASK_L    0x0000d90003530000ull   // 11 bits: cuts readily after it
+#define SYNC_SCAN_BUF  (1024 * 1024)
+#define SYNC_RAW       0
+#define SYNC_LZ        1
+
+typedef struct {
+    unsigned char hash[32];
+    uint32_t len;
+} SyncChunk;
+
+typedef struct {
+    uint64_t size, dev, ino;
+    int64_t mtime_ns;
+    unsigned char base[32];     // root of the version last pushed or pulled
+    SyncChunk *chunks;
+    uint32_t count, cap;
+} SyncManifest;
+
+// How a pull treats a local file that has changed since it last synced.
+typedef enum {
+    SYNC_WHOLE,     // keep it; only an untouched file takes the backup's version
+    SYNC_LINES,     // merge in the backup's lines it lacks (append-only logs)
+} SyncMode;
+
+typedef struct {
+    uint32_t chunks;            // in the file
+    uint32_t moved;             // written to the target, or read from it
+    uint64_t bytes;             // ... and their stored size
+    uint64_t lines;             // lines a merge added
+    int rewritten;              // ... not all at the end: the file was rebuilt
+    const char *outcome;        // what a pull did
+} SyncReport;
+
+static inline void sync_free(SyncManifest *m) {
+    free(m->chunks);
+    memset(m, 0, sizeof(*m));
+}
+
+static inline int sync_add(SyncManifest *m, const unsigned char hash[32], uint32_t len) {
+    if (m->count == m->cap) {
+        uint32_t cap = m->cap ? m->cap * 2 : 256;
+        SyncChunk *c = realloc(m->chunks, cap * sizeof(SyncChunk));
+        if (!c) return 0;
+        m->chunks = c;
+        m->cap = cap;
+    }
+    memcpy(m->chunks[m->count].hash, hash, 32);
+    m->chunks[m->count++].len = len;
+    return 1;
+}
+
+static inline uint64_t sync_offset(const SyncManifest *m, uint32_t k) {
+    uint64_t off = 0;
+    for (uint32_t i = 0; i < k; i++) off += m->chunks[i].len;
+    return off;
+}
+
+// Identifies a version of a file: its size and chunk list.
+static inline void sync_root(const SyncManifest *m, unsigned char out[32]) {
+    Sha256 s;
+    unsigned char b[8];
+    sha256_init(&s);
+    put_le64(b, m->size);
+    sha256_update(&s, b, 8);
+    for (uint32_t i = 0; i < m->count; i++) {
+        sha256_update(&s, m->chunks[i].hash, 32);
+        put_le32(b, m->chunks[i].len);
+        sha256_update(&s, b, 4);
+    }
+    sha256_final(&s, out);
+}
+
+static inline int sync_has_base(const SyncManifest *m) {
+    static const unsigned char zero[32];
+    return memcmp(m->base, zero, 32) != 0;
+}
+
+static inline int sync_read_at(int fd, unsigned char *p, size_t n, uint64_t off) {
+    while (n) {
+        ssize_t r = pread(fd, p, n, (off_t)off);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return 0;
+        p += r;
+        n -= (size_t)r;
+        off += (uint64_t)r;
+    }
+    return 1;
+}
+
+static inline int sync_write_all(int fd, const unsigned char *p, size_t n) {
+    while (n) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 1;
+}
+
+// ---------------------------------------------------
+// Chunking
+// ---------------------------------------------------
+// The gear table is part of the format: chunk boundaries, and so which
+// chunks two versions share, depend on it. It comes from splitmix64.
+static uint64_t sync_gear[256];
+
+static inline void sync_gear_init(void) {
+    uint64_t x = 0x466f72656e7a6full;       // "Forenzo"
+    for (int i = 0; i < 256; i++) {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        sync_gear[i] = z ^ (z >> 31);
+    }
+}
+
+// Length of the chunk starting at p, given n bytes; n must reach
+// SYNC_MAX_CHUNK unless the file ends sooner.
+static inline size_t sync_cut(const unsigned char *p, size_t n) {
+    if (!sync_gear[0]) sync_gear_init();
+    if (n <= SYNC_MIN_CHUNK) return n;
+    size_t normal = n < SYNC_AVG_CHUNK ? n : SYNC_AVG_CHUNK;
+    size_t max = n < SYNC_MAX_CHUNK ? n : SYNC_MAX_CHUNK, i = SYNC_MIN_CHUNK;
+    uint64_t h = 0;
+    for (; i < normal; i++) {
+        h = (h << 1) + sync_gear[p[i]];
+        if (!(h & SYNC_MASK_S)) return i + 1;
+    }
+    for (; i < max; i++) {
+        h = (h << 1) + sync_gear[p[i]];
+        if (!(h & SYNC_MASK_L)) return i + 1;
+    }
+    return i;
+}
+
+// Appends the chunks of fd's bytes [from, size) to m.
+static inline int sync_scan(int fd, uint64_t from, uint64_t size, SyncManifest *m) {
+    unsigned char *buf = malloc(SYNC_SCAN_BUF);
+    if (!buf) return 0;
+    size_t have = 0, pos = 0;
+    uint64_t next = from;       // file offset of buf[have]
+    int ok = 1;
+    while (ok && (pos < have || next < size)) {
+        if (have - pos < SYNC_MAX_CHUNK && next < size) {
+            memmove(buf, buf + pos, have - pos);
+            have -= pos;
+            pos = 0;
+            size_t want = SYNC_SCAN_BUF - have;
+            if (want > size - next) want = (size_t)(size - next);
+            if (!sync_read_at(fd, buf + have, want, next)) { ok = 0; break; }
+            have += want;
+            next += want;
+        }
+        size_t len = sync_cut(buf + pos, have - pos);
+        unsigned char hash[32];
+        sha256(buf + pos, len, hash);
+        ok = sync_add(m, hash, (uint32_t)len);
+        pos += len;
+    }
+    free(buf);
+    return ok;
+}
+
+// ---------------------------------------------------
+// Manifests
+// ---------------------------------------------------
+static inline int sync_write_manifest(const char *path, const SyncManifest *m) {
+    size_t n = SYNC_HEADER + (size_t)m->count * SYNC_ENTRY + 4;
+    unsigned char *b = malloc(n), *p = b;
+    if (!b) return 0;
+    memcpy(p, SYNC_MAGIC, 4);
+    put_le32(p + 4, SYNC_VERSION);
+    put_le64(p + 8, m->size);
+    put_le64(p + 16, m->dev);
+    put_le64(p + 24, m->ino);
+    put_le64(p + 32, (uint64_t)m->mtime_ns);
+    memcpy(p + 40, m->base, 32);
+    put_le32(p + 72, m->count);
+    p += SYNC_HEADER;
+    for (uint32_t i = 0; i < m->count; i++, p += SYNC_ENTRY) {
+        memcpy(p, m->chunks[i].hash, 32);
+        put_le32(p + 32, m->chunks[i].len);
+    }
+    put_le32(p, crc32_update(0, b, (size_t)(p - b)));
+
+    char tmp[1100];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644), ok = fd >= 0;
+    if (ok) ok = sync_write_all(fd, b, n) && fsync(fd) == 0;
+    if (fd >= 0 && close(fd) != 0) ok = 0;
+    if (ok) ok = rename(tmp, path) == 0;
+    if (!ok) { perror(path); unlink(tmp); }
+    free(b);
+    return ok;
+}
+
+// Returns 1, 0 when there is no manifest, -1 when it is damaged.
+static inline int sync_read_manifest(const char *path, SyncManifest *m) {
+    memset(m, 0, sizeof(*m));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return errno == ENOENT ? 0 : (perror(path), -1);
+    struct stat st;
+    unsigned char *b = NULL;
+    int ok = fstat(fd, &st) == 0 && st.st_size >= SYNC_HEADER + 4 &&
+             (b = malloc((size_t)st.st_size)) && sync_read_at(fd, b, (size_t)st.st_size, 0);
+    close(fd);
+    size_t n = ok ? (size_t)st.st_size : 0;
+    uint32_t count = ok ? get_le32(b + 72) : 0;
+    ok = ok && memcmp(b, SYNC_MAGIC, 4) == 0 && get_le32(b + 4) == SYNC_VERSION &&
+         n == SYNC_HEADER + (size_t)count * SYNC_ENTRY + 4 &&
+         get_le32(b + n - 4) == crc32_update(0, b, n - 4);
+    if (ok) {
+        m->size = get_le64(b + 8);
+        m->dev = get_le64(b + 16);
+        m->ino = get_le64(b + 24);
+        m->mtime_ns = (int64_t)get_le64(b + 32);
+        memcpy(m->base, b + 40, 32);
+        const unsigned char *p = b + SYNC_HEADER;
+        for (uint32_t i = 0; ok && i < count; i++, p += SYNC_ENTRY) {
+            uint32_t len = get_le32(p + 32);
+            ok = len > 0 && len <= SYNC_MAX_CHUNK && sync_add(m, p, len);
+        }
+        ok = ok && sync_offset(m, m->count) == m->size;
+    }
+    free(b);
+    if (!ok) {
+        fprintf(stderr, "%s: damaged manifest\n", path);
+        sync_free(m);
+        return -1;
+    }
+    return 1;
+}
+
+// ---------------------------------------------------
+// Local files
+// ---------------------------------------------------
+static inline void sync_cache_path(char *out, size_t n, const char *path) {
+    snprintf(out, n, "%s.sync", path);
+}
+
+static inline void sync_identity(SyncManifest *m, const struct stat *st) {
+    m->size = (uint64_t)st->st_size;
+    m->dev = (uint64_t)st->st_dev;
+    m->ino = (uint64_t)st->st_ino;
+#ifdef __APPLE__
+    m->mtime_ns = (int64_t)st->st_mtimespec.tv_sec * 1000000000 + st->st_mtimespec.tv_nsec;
+#else
+    m->mtime_ns = (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+#endif
+}
+
+// Chunks of path into m, from the cache where it still describes the file.
+// Returns 1, 0 when the file does not exist, -1 on error.
+static inline int sync_local(const char *path, SyncManifest *m) {
+    char cache[1100];
+    sync_cache_path(cache, sizeof(cache), path);
+    memset(m, 0, sizeof(*m));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return errno == ENOENT ? 0 : (perror(path), -1);
+    struct stat st;
+    if (fstat(fd, &st) != 0) { perror(path); close(fd); return -1; }
+    SyncManifest now;
+    memset(&now, 0, sizeof(now));
+    sync_identity(&now, &st);
+
+    SyncManifest c;
+    uint64_t from = 0;
+    if (sync_read_manifest(cache, &c) == 1 && c.dev == now.dev && c.ino == now.ino) {
+        memcpy(now.base, c.base, 32);
+        if (c.size == now.size && c.mtime_ns == now.mtime_ns) {
+            sync_free(&now);
+            *m = c;
+            close(fd);
+            return 1;
+        }
+        if (c.count && c.size < now.size) {
+            // grown in place: keep every chunk but the last, if that is intact
+            SyncChunk *last = &c.chunks[c.count - 1];
+            uint64_t off = c.size - last->len;
+            unsigned char *b = malloc(last->len), hash[32];
+            if (b && sync_read_at(fd, b, last->len, off)) {
+                sha256(b, last->len, hash);
+                if (memcmp(hash, last->hash, 32) == 0) {
+                    c.count--;
+                    from = off;
+                }
+            }
+            free(b);
+        }
+        if (from) {
+            free(now.chunks);
+            now.chunks = c.chunks;
+            now.count = c.count;
+            now.cap = c.cap;
+            c.chunks = NULL;
+        }
+        sync_free(&c);
+    }
+    int ok = sync_scan(fd, from, now.size, &now);
+    close(fd);
+    if (!ok) { perror(path); sync_free(&now); return -1; }
+    *m = now;
+    return 1;
+}
+
+// Records m (restating path) as the cache, with base as the synced version.
+static inline void sync_save_local(const char *path, SyncManifest *m, const unsigned char base[32]) {
+    char cache[1100];
+    struct stat st;
+    if (stat(path, &st) != 0) return;
+    sync_identity(m, &st);
+    memmove(m->base, base, 32);
+    sync_cache_path(cache, sizeof(cache), path);
+    sync_write_manifest(cache, m);
+}
+
+// ---------------------------------------------------
+// Chunk store
+// ---------------------------------------------------
+static inline void sync_chunk_path(char *out, size_t n, const char *dir, const unsigned char hash[32]) {
+    char hex[65];
+    sha256_hex(hash, hex);
+    snprintf(out, n, "%s/chunks/%.2s/%s", dir, hex, hex + 2);
+}
+
+static inline int sync_mkdir(const char *path) {
+    if (mkdir(path, 0755) == 0 || errno == EEXIST) return 1;
+    perror(path);
+    return 0;
+}
+
+// Stores one chunk unless the target has it; returns the bytes written,
+// 0 when it was already there, -1 on error.
+static inline long sync_put_chunk(const char *dir, const unsigned char hash[32], const unsigned char *p,
+                                  size_t n, LzMatcher *lz, unsigned char *scratch) {
+    char path[1100], tmp[1200];
+    sync_chunk_path(path, sizeof(path), dir, hash);
+    if (access(path, F_OK) == 0) return 0;
+    char *slash = strrchr(path, '/');
+    *slash = '\0';
+    int ok = sync_mkdir(path);
+    *slash = '/';
+    if (!ok) return -1;
+
+    size_t stored = lz_compress(lz, p, n, scratch + 5);
+    scratch[0] = SYNC_LZ;
+    if (stored >= n) {
+        memcpy(scratch + 5, p, n);
+        stored = n;
+        scratch[0] = SYNC_RAW;
+    }
+    put_le32(scratch + 1, (uint32_t)n);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ok = fd >= 0 && sync_write_all(fd, scratch, stored + 5) && fsync(fd) == 0;
+    if (fd >= 0 && close(fd) != 0) ok = 0;
+    if (ok) ok = rename(tmp, path) == 0;
+    if (!ok) { perror(path); unlink(tmp); return -1; }
+    return (long)(stored + 5);
+}
+
+// Reads and verifies one chunk into out (SYNC_MAX_CHUNK bytes); scratch
+// holds lz_bound(SYNC_MAX_CHUNK) + 5. Returns the stored size or -1.
+static inline long sync_get_chunk(const char *dir, const SyncChunk *c, unsigned char *out, unsigned char *scratch) {
+    char path[1100];
+    sync_chunk_path(path, sizeof(path), dir, c->hash);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { perror(path); return -1; }
+    struct stat st;
+    size_t n = 0;
+    int ok = fstat(fd, &st) == 0 && st.st_size > 5 && (size_t)st.st_size <= lz_bound(SYNC_MAX_CHUNK) + 5 &&
+             sync_read_at(fd, scratch, n = (size_t)st.st_size, 0);
+    close(fd);
+    ok = ok && get_le32(scratch + 1) == c->len;
+    if (ok && scratch[0] == SYNC_LZ) ok = lz_decompress(scratch + 5, n - 5, out, c->len);
+    else if (ok) ok = scratch[0] == SYNC_RAW && n - 5 == c->len;
+    if (ok && scratch[0] == SYNC_RAW) memcpy(out, scratch + 5, c->len);
+    unsigned char hash[32];
+    if (ok) sha256(out, c->len, hash);
+    if (!ok || memcmp(hash, c->hash, 32) != 0) {
+        fprintf(stderr, "%s: damaged chunk\n", path);
+        return -1;
+    }
+    return (long)n;
+}
+
+// ---------------------------------------------------
+// Push
+// ---------------------------------------------------
+static inline void sync_manifest_path(char *out, size_t n, const char *dir, const char *name) {
+    snprintf(out, n, "%s/%s.fzm", dir, name);
+}
+
+// Backs path up to dir as name. Returns 1 or 0 (reported).
+static inline int sync_push(const char *dir, const char *path, const char *name, SyncReport *r) {
+    memset(r, 0, sizeof(*r));
+    SyncManifest m;
+    int st = sync_local(path, &m);
+    if (st == 0) fprintf(stderr, "%s: no such file\n", path);
+    if (st <= 0) return 0;
+    char chunks[1100];
+    snprintf(chunks, sizeof(chunks), "%s/chunks", dir);
+    LzMatcher *lz = malloc(sizeof(LzMatcher));
+    unsigned char *buf = malloc(SYNC_MAX_CHUNK), *scratch = malloc(lz_bound(SYNC_MAX_CHUNK) + 5);
+    int fd = open(path, O_RDONLY);
+    int ok = lz && buf && scratch && fd >= 0 && sync_mkdir(dir) && sync_mkdir(chunks);
+    uint64_t off = 0;
+    for (uint32_t i = 0; ok && i < m.count; off += m.chunks[i++].len) {
+        char cp[1100];
+        sync_chunk_path(cp, sizeof(cp), dir, m.chunks[i].hash);
+        if (access(cp, F_OK) == 0) continue;
+        unsigned char hash[32];
+        ok = sync_read_at(fd, buf, m.chunks[i].len, off);
+        if (ok) sha256(buf, m.chunks[i].len, hash);
+        if (ok && memcmp(hash, m.chunks[i].hash, 32) != 0) {
+            fprintf(stderr, "%s: changed while syncing\n", path);
+            ok = 0;
+        }
+        long w = ok ? sync_put_chunk(dir, m.chunks[i].hash, buf, m.chunks[i].len, lz, scratch) : -1;
+        if (w < 0) ok = 0;
+        else if (w > 0) { r->moved++; r->bytes += (uint64_t)w; }
+    }
+    if (fd >= 0) close(fd);
+    free(lz);
+    free(buf);
+    free(scratch);
+    r->chunks = m.count;
+    if (ok) {
+        SyncManifest remote = m;
+        unsigned char root[32];
+        remote.dev = remote.ino = 0;
+        remote.mtime_ns = 0;
+        memset(remote.base, 0, 32);
+        char mp[1100];
+        sync_manifest_path(mp, sizeof(mp), dir, name);
+        ok = sync_write_manifest(mp, &remote);
+        sync_root(&m, root);
+        if (ok) sync_save_local(path, &m, root);
+    }
+    sync_free(&m);
+    return ok;
+}
+
+// ---------------------------------------------------
+// Pull
+// ---------------------------------------------------
+typedef struct {
+    const char *dir;
+    unsigned char *buf, *scratch;
+    SyncReport *r;
+    int damaged;                // a chunk was missing or bad (already reported)
+} SyncFetch;
+
+static inline int sync_fetch(SyncFetch *f, const SyncChunk *c) {
+    long n = sync_get_chunk(f->dir, c, f->buf, f->scratch);
+    if (n < 0) return !(f->damaged = 1);
+    f->r->moved++;
+    f->r->bytes += (uint64_t)n;
+    return 1;
+}
+
+static inline uint32_t sync_common(const SyncManifest *a, const SyncManifest *b) {
+    uint32_t k = 0;
+    while (k < a->count && k < b->count && a->chunks[k].len == b->chunks[k].len &&
+           memcmp(a->chunks[k].hash, b->chunks[k].hash, 32) == 0)
+        k++;
+    return k;
+}
+
+// Local chunks by hash, for rebuilding a file out of both sides.
+typedef struct {
+    uint32_t *slots;            // chunk index + 1, 0 = empty
+    uint32_t mask;
+    uint64_t *offsets;
+} SyncChunkMap;
+
+static inline int sync_map_build(SyncChunkMap *map, const SyncManifest *m) {
+    uint32_t n = 16;
+    while (n < m->count * 2) n *= 2;
+    map->mask = n - 1;
+    map->slots = calloc(n, sizeof(uint32_t));
+    map->offsets = malloc((m->count + 1) * sizeof(uint64_t));
+    if (!map->slots || !map->offsets) return 0;
+    uint64_t off = 0;
+    for (uint32_t i = 0; i < m->count; off += m->chunks[i++].len) {
+        map->offsets[i] = off;
+        uint32_t s = get_le32(m->chunks[i].hash) & map->mask;
+        while (map->slots[s]) s = (s + 1) & map->mask;
+        map->slots[s] = i + 1;
+    }
+    return 1;
+}
+
+static inline int64_t sync_map_find(const SyncChunkMap *map, const SyncManifest *m, const SyncChunk *c) {
+    for (uint32_t s = get_le32(c->hash) & map->mask; map->slots[s]; s = (s + 1) & map->mask) {
+        const SyncChunk *l = &m->chunks[map->slots[s] - 1];
+        if (l->len == c->len && memcmp(l->hash, c->hash, 32) == 0) return (int64_t)map->offsets[map->slots[s] - 1];
+    }
+    return -1;
+}
+
+// Makes path the remote version. A file the remote only extends is
+// truncated to the shared chunks and appended to; anything else is
+// rebuilt beside it, from local chunks where it has them, and renamed.
+static inline int sync_replace(SyncFetch *f, const char *path, const SyncManifest *local, const SyncManifest *remote) {
+    uint32_t k = sync_common(local, remote);
+    if (local->count && k + 1 >= local->count) {
+        int fd = open(path, O_WRONLY | O_CREAT, 0644);
+        if (fd < 0) { perror(path); return 0; }
+        int ok = ftruncate(fd, (off_t)sync_offset(remote, k)) == 0 && lseek(fd, 0, SEEK_END) >= 0;
+        for (uint32_t i = k; ok && i < remote->count; i++)
+            ok = sync_fetch(f, &remote->chunks[i]) && sync_write_all(fd, f->buf, remote->chunks[i].len);
+        if (ok) ok = fsync(fd) == 0;
+        if (close(fd) != 0) ok = 0;
+        if (!ok && !f->damaged) perror(path);
+        return ok;
+    }
+
+    SyncChunkMap map = {0};
+    char tmp[1100];
+    snprintf(tmp, sizeof(tmp), "%s.pull", path);
+    int in = open(path, O_RDONLY), out = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int ok = (in >= 0 || !local->count) && out >= 0 && sync_map_build(&map, local);
+    for (uint32_t i = 0; ok && i < remote->count; i++) {
+        const SyncChunk *c = &remote->chunks[i];
+        int64_t at = sync_map_find(&map, local, c);
+        unsigned char hash[32];
+        int have = 0;
+        if (at >= 0 && sync_read_at(in, f->buf, c->len, (uint64_t)at)) {
+            sha256(f->buf, c->len, hash);
+            have = memcmp(hash, c->hash, 32) == 0;
+        }
+        ok = (have || sync_fetch(f, c)) && sync_write_all(out, f->buf, c->len);
+    }
+    if (ok) ok = fsync(out) == 0;
+    if (out >= 0 && close(out) != 0) ok = 0;
+    if (in >= 0) close(in);
+    if (ok) ok = rename(tmp, path) == 0;
+    if (!ok && !f->damaged) perror(path);
+    if (!ok) unlink(tmp);
+    free(map.slots);
+    free(map.offsets);
+    return ok;
+}
+
+// Line-wise merge for append-only logs. The remote lines after the shared
+// chunks that the local tail does not already hold (as a multiset, so
+// repeated lines survive) are merged into that tail by time: the string
+// value of key in each line, which for ISO 8601 stamps sorts as text. A
+// line without one sorts with the line before it; ties keep local lines
+// first, and with no key the remote lines simply follow. When they all
+// land after the local tail the file is appended to; otherwise it is
+// rebuilt beside itself and renamed over, and r->rewritten is set, since
+// anything that indexed the old file by offset is now wrong.
+typedef struct {
+    size_t off, n;              // in the tail or in the added lines
+    size_t stamp, stamp_n;      // key's value, within the same buffer
+    int newline;                // ended in '\n' (else: a torn last line)
+} SyncLine;
+
+typedef struct {
+    SyncLine *v;
+    size_t n, cap;
+} SyncLines;
+
+typedef struct {
+    int fd, ok;
+    const char *key;
+    InternTable seen;           // local tail lines ...
+    uint32_t *counts, nlocal;   // ... and how often each occurs
+    SyncLines local, remote;
+    char *add;                  // the remote lines to add, back to back
+    size_t add_n, add_cap;
+    char *out;
+    size_t out_n;
+    uint64_t lines;
+} SyncMerge;
+
+static inline void sync_merge_write(SyncMerge *mg, const char *s, size_t n) {
+    if (!mg->ok) return;
+    if (n > SYNC_SCAN_BUF - mg->out_n) {
+        mg->ok = sync_write_all(mg->fd, (unsigned char *)mg->out, mg->out_n);
+        mg->out_n = 0;
+    }
+    if (n > SYNC_SCAN_BUF) { mg->ok = mg->ok && sync_write_all(mg->fd, (const unsigned char *)s, n); return; }
+    memcpy(mg->out + mg->out_n, s, n);
+    mg->out_n += n;
+}
+
+// Where key's string value starts in s[0..n), or n when the line has none.
+static inline size_t sync_line_stamp(const char *s, size_t n, const char *key, size_t *len) {
+    size_t k = strlen(key);
+    for (size_t i = 0; i + k + 2 <= n; i++) {
+        if (s[i] != '"' || memcmp(s + i + 1, key, k) != 0 || s[i + k + 1] != '"') continue;
+        size_t j = i + k + 2;
+        while (j < n && (s[j] == ' ' || s[j] == ':')) j++;
+        if (j == n || s[j] != '"') continue;
+        const char *end = memchr(s + j + 1, '"', n - j - 1);
+        if (!end) break;
+        *len = (size_t)(end - s) - j - 1;
+        return j + 1;
+    }
+    *len = 0;
+    return n;
+}
+
+static inline void sync_lines_add(SyncMerge *mg, SyncLines *ls, const char *base, size_t off, size_t n, int newline) {
+    if (ls->n == ls->cap) {
+        size_t cap = ls->cap ? ls->cap * 2 : 256;
+        SyncLine *v = realloc(ls->v, cap * sizeof(SyncLine));
+        if (!v) { mg->ok = 0; return; }
+        ls->v = v;
+        ls->cap = cap;
+    }
+    SyncLine *l = &ls->v[ls->n];
+    l->off = off;
+    l->n = n;
+    l->newline = newline;
+    size_t at = n, len = 0;
+    if (mg->key) at = sync_line_stamp(base + off, n, mg->key, &len);
+    if (at < n) {
+        l->stamp = off + at;
+        l->stamp_n = len;
+    } else if (ls->n) {
+        l->stamp = ls->v[ls->n - 1].stamp;
+        l->stamp_n = ls->v[ls->n - 1].stamp_n;
+    } else {
+        l->stamp = l->stamp_n = 0;
+    }
+    ls->n++;
+}
+
+static inline void sync_merge_local(SyncMerge *mg, const char *tail, size_t off, size_t n, int newline) {
+    uint32_t id = intern_insert(&mg->seen, tail + off, n, 0);
+    if (id == INTERN_NONE) { mg->ok = 0; return; }
+    if (id == mg->nlocal) {
+        uint32_t *c = realloc(mg->counts, (mg->nlocal + 1) * sizeof(uint32_t));
+        if (!c) { mg->ok = 0; return; }
+        mg->counts = c;
+        mg->counts[mg->nlocal++] = 0;
+    }
+    mg->counts[id]++;
+    sync_lines_add(mg, &mg->local, tail, off, n, newline);
+}
+
+static inline void sync_merge_remote(SyncMerge *mg, const char *s, size_t n, int newline) {
+    uint32_t id = intern_insert(&mg->seen, s, n, 0);
+    if (id == INTERN_NONE) { mg->ok = 0; return; }
+    if (id < mg->nlocal && mg->counts[id]) { mg->counts[id]--; return; }
+    if (n > mg->add_cap - mg->add_n) {
+        size_t cap = mg->add_cap ? mg->add_cap : 64 * 1024;
+        while (cap - mg->add_n < n) cap *= 2;
+        char *a = realloc(mg->add, cap);
+        if (!a) { mg->ok = 0; return; }
+        mg->add = a;
+        mg->add_cap = cap;
+    }
+    memcpy(mg->add + mg->add_n, s, n);
+    sync_lines_add(mg, &mg->remote, mg->add, mg->add_n, n, newline);
+    mg->add_n += n;
+    mg->lines++;
+}
+
+// Whether remote line b sorts before local line a.
+static inline int sync_line_before(const SyncMerge *mg, const char *tail, const SyncLine *a, const SyncLine *b) {
+    size_t n = a->stamp_n < b->stamp_n ? a->stamp_n : b->stamp_n;
+    int c = memcmp(mg->add + b->stamp, tail + a->stamp, n);
+    return c < 0 || (c == 0 && b->stamp_n < a->stamp_n);
+}
+
+static inline void sync_merge_put(SyncMerge *mg, const char *base, const SyncLine *l, int last) {
+    sync_merge_write(mg, base + l->off, l->n);
+    if (l->newline || !last) sync_merge_write(mg, "\n", 1);
+}
+
+// Start of the line byte off falls in: just past the newline before it.
+static inline uint64_t sync_line_start(int fd, uint64_t off) {
+    unsigned char b[4096];
+    while (off) {
+        size_t n = off < sizeof(b) ? (size_t)off : sizeof(b);
+        if (!sync_read_at(fd, b, n, off - n)) return off;
+        for (size_t i = n; i--;)
+            if (b[i] == '\n') return off - n + i + 1;
+        off -= n;
+    }
+    return 0;
+}
+
+// Writes the shared head [0, start) of in and the merged tail to
+// path.merge and renames it over path.
+static inline int sync_merge_rewrite(SyncMerge *mg, SyncFetch *f, const char *path, int in,
+                                     uint64_t start, const char *tail) {
+    char tmp[1100];
+    snprintf(tmp, sizeof(tmp), "%s.merge", path);
+    mg->fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (mg->fd < 0) return 0;
+    for (uint64_t off = 0; mg->ok && off < start;) {
+        size_t n = start - off < SYNC_MAX_CHUNK ? (size_t)(start - off) : SYNC_MAX_CHUNK;
+        mg->ok = sync_read_at(in, f->buf, n, off) && sync_write_all(mg->fd, f->buf, n);
+        off += n;
+    }
+    size_t i = 0, j = 0, total = mg->local.n + mg->remote.n;
+    for (size_t k = 0; mg->ok && k < total; k++) {
+        int remote = j < mg->remote.n &&
+                     (i == mg->local.n || sync_line_before(mg, tail, &mg->local.v[i], &mg->remote.v[j]));
+        if (remote) sync_merge_put(mg, mg->add, &mg->remote.v[j++], k + 1 == total);
+        else sync_merge_put(mg, tail, &mg->local.v[i++], k + 1 == total);
+    }
+    if (mg->ok && mg->out_n) mg->ok = sync_write_all(mg->fd, (unsigned char *)mg->out, mg->out_n);
+    if (mg->ok) mg->ok = fsync(mg->fd) == 0;
+    if (close(mg->fd) != 0) mg->ok = 0;
+    mg->fd = -1;
+    if (mg->ok) mg->ok = rename(tmp, path) == 0;
+    if (!mg->ok) unlink(tmp);
+    return mg->ok;
+}
+
+static inline int sync_merge_lines(SyncFetch *f, const char *path, const char *key,
+                                   const SyncManifest *local, const SyncManifest *remote) {
+    uint32_t k = sync_common(local, remote);
+    if (k == remote->count) return 1;       // the local file holds all of it
+    SyncMerge mg;
+    memset(&mg, 0, sizeof(mg));
+    mg.key = key;
+    int in = open(path, O_RDONLY);
+    if (in < 0) { perror(path); return 0; }
+    // The shared chunks usually end mid-line; both tails start at that
+    // line, whose shared head is read locally and carried into the remote.
+    uint64_t off = sync_offset(local, k), start = sync_line_start(in, off);
+    size_t tail_n = (size_t)(local->size - start), carry_n = (size_t)(off - start), carry_cap = carry_n;
+    char *tail = malloc(tail_n + 1), *carry = malloc(carry_cap + 1);
+    mg.out = malloc(SYNC_SCAN_BUF);
+    mg.ok = tail && carry && mg.out && sync_read_at(in, (unsigned char *)tail, tail_n, start);
+    if (mg.ok) memcpy(carry, tail, carry_n);
+    for (size_t i = 0; mg.ok && i < tail_n;) {
+        char *nl = memchr(tail + i, '\n', tail_n - i);
+        size_t len = nl ? (size_t)(nl - tail) - i : tail_n - i;
+        sync_merge_local(&mg, tail, i, len, nl != NULL);
+        i += len + 1;
+    }
+
+    for (uint32_t i = k; mg.ok && i < remote->count; i++) {
+        const SyncChunk *c = &remote->chunks[i];
+        if (!sync_fetch(f, c)) { mg.ok = 0; break; }
+        const char *p = (const char *)f->buf, *end = p + c->len;
+        while (mg.ok && p < end) {
+            const char *nl = memchr(p, '\n', (size_t)(end - p));
+            size_t len = nl ? (size_t)(nl - p) : (size_t)(end - p);
+            if (!nl || carry_n) {                   // a line split across chunks
+                if (carry_n + len > carry_cap) {
+                    size_t cap = carry_cap > 4096 ? carry_cap : 4096;
+                    while (cap < carry_n + len) cap *= 2;
+                    char *cr = realloc(carry, cap);
+                    if (!cr) { mg.ok = 0; break; }
+                    carry = cr;
+                    carry_cap = cap;
+                }
+                memcpy(carry + carry_n, p, len);
+                carry_n += len;
+                if (!nl) break;
+                sync_merge_remote(&mg, carry, carry_n, 1);
+                carry_n = 0;
+            } else {
+                sync_merge_remote(&mg, p, len, 1);
+            }
+            p = nl + 1;
+        }
+    }
+    if (mg.ok && carry_n) sync_merge_remote(&mg, carry, carry_n, 0);   // a torn last line stays torn
+
+    // Appending keeps the order unless a new line sorts before the local
+    // tail's last one.
+    const SyncLine *last = mg.local.n ? &mg.local.v[mg.local.n - 1] : NULL;
+    int append = 1;
+    for (size_t i = 0; last && append && i < mg.remote.n; i++)
+        append = !sync_line_before(&mg, tail, last, &mg.remote.v[i]);
+    if (mg.ok && mg.remote.n && append) {
+        mg.fd = open(path, O_WRONLY | O_APPEND);
+        mg.ok = mg.fd >= 0;
+        if (mg.ok && last && !last->newline) sync_merge_write(&mg, "\n", 1);
+        for (size_t i = 0; mg.ok && i < mg.remote.n; i++)
+            sync_merge_put(&mg, mg.add, &mg.remote.v[i], i + 1 == mg.remote.n);
+        if (mg.ok && mg.out_n) mg.ok = sync_write_all(mg.fd, (unsigned char *)mg.out, mg.out_n);
+        if (mg.ok) mg.ok = fsync(mg.fd) == 0;
+        if (mg.fd >= 0 && close(mg.fd) != 0) mg.ok = 0;
+    } else if (mg.ok && mg.remote.n) {
+        f->r->rewritten = sync_merge_rewrite(&mg, f, path, in, start, tail);
+    }
+    close(in);
+    if (!mg.ok && !f->damaged) perror(path);
+    f->r->lines = mg.lines;
+    intern_close(&mg.seen);
+    free(mg.counts);
+    free(mg.local.v);
+    free(mg.remote.v);
+    free(mg.add);
+    free(mg.out);
+    free(tail);
+    free(carry);
+    return mg.ok;
+}
+
+// Restores or updates path from name in dir; a SYNC_LINES merge orders
+// lines by key (NULL: backup lines go last). Returns 1 (r->outcome says
+// what happened), 0 when the backup has no such file, -1 on error.
+// Holds an exclusive flock on path throughout, and keeps the file when
+// that is not free: a process with it locked (forenzo takes a shared lock
+// on its state log) holds offsets into it that a pull would invalidate.
+static inline int sync_pull(const char *dir, const char *name, const char *path, SyncMode mode,
+                            const char *key, SyncReport *r) {
+    memset(r, 0, sizeof(*r));
+    char mp[1100];
+    sync_manifest_path(mp, sizeof(mp), dir, name);
+    SyncManifest remote, local;
+    int st = sync_read_manifest(mp, &remote);
+    if (st <= 0) return st;
+    r->chunks = remote.count;
+    int lock = open(path, O_RDONLY);
+    if (lock >= 0 && flock(lock, LOCK_EX | LOCK_NB) != 0) {
+        int busy = errno == EWOULDBLOCK;
+        if (!busy) perror(path);
+        close(lock);
+        sync_free(&remote);
+        r->outcome = "kept, in use by another process";
+        return busy ? 1 : -1;
+    }
+    st = sync_local(path, &local);
+    if (st < 0) {
+        if (lock >= 0) close(lock);
+        sync_free(&remote);
+        return -1;
+    }
+
+    unsigned char rroot[32], lroot[32];
+    sync_root(&remote, rroot);
+    sync_root(&local, lroot);
+    SyncFetch f = { dir, malloc(SYNC_MAX_CHUNK), malloc(lz_bound(SYNC_MAX_CHUNK) + 5), r, 0 };
+    int ok = f.buf && f.scratch, merged = 0;
+    if (!ok) perror("sync_pull");
+    else if (st == 0) {
+        r->outcome = "restored";
+        ok = sync_replace(&f, path, &local, &remote);
+    } else if (memcmp(rroot, lroot, 32) == 0) {
+        r->outcome = "up to date";
+    } else if (sync_has_base(&local) && memcmp(rroot, local.base, 32) == 0) {
+        r->outcome = "kept, newer than the backup";
+    } else if (mode == SYNC_LINES) {
+        r->outcome = "merged";
+        sync_save_local(path, &local, local.base);     // so the rechunk below resumes
+        ok = sync_merge_lines(&f, path, key, &local, &remote);
+        merged = 1;
+    } else if (sync_has_base(&local) && memcmp(lroot, local.base, 32) == 0) {
+        r->outcome = "updated";
+        ok = sync_replace(&f, path, &local, &remote);
+    } else {
+        r->outcome = "kept, changed here and in the backup";
+    }
+    free(f.buf);
+    free(f.scratch);
+
+    if (ok && r->outcome[0] != 'k') {     // not "kept, ..."
+        if (merged) {
+            sync_free(&local);
+            if (sync_local(path, &local) != 1) ok = 0;
+        } else {
+            SyncManifest tmp = local;
+            local = remote;
+            remote = tmp;
+            memset(local.base, 0, 32);
+        }
+        sync_save_local(path, &local, rroot);
+    }
+    if (lock >= 0) close(lock);
+    sync_free(&remote);
+    sync_free(&local);
+    return ok ? 1 : -1;
+}
+
+#endif // FORENZO_SYNC_H
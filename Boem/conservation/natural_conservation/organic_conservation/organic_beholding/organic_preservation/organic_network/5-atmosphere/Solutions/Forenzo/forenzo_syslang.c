@@ -1,109 +1,468 @@
 // forenzo_syslang.c — Forenzo himself interprets System Language
+// Compile: clang -o forenzo_syslang forenzo_syslang.c -lpthread
+// Run: ./forenzo_syslang [--verify]
+//      ./forenzo_syslang --run <program.bin|-> [--quiet]
+//      ./forenzo_syslang --bench-exec N
+//      ./forenzo_syslang --summarize [collection]
+//      ./forenzo_syslang --archive-export <file>   (compressed copy of forenzo.bin and its text)
+//      ./forenzo_syslang --archive-import <file>   (restore it, into an empty directory)
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "forenzo_store.h"      // MemoryToken, mmap-backed forenzo.bin
+#include "forenzo_intern.h"     // string <-> id dictionary
+#include "forenzo_postings.h"   // collection -> tokens index
+#include "forenzo_snapshot.h"   // checkpoint of the collection index
+#include "forenzo_metrics.h"    // batch latencies, printed after --run
+#include "forenzo_archive.h"    // --archive-export / --archive-import
 
 #define MEMORY_FILE "forenzo.bin"
+#define DICTIONARY_FILE "forenzo.dict"
+#define COLLECTIONS_FILE "forenzo.collections.dict"
+#define COLLECTION_INDEX_FILE "forenzo.cidx"
+#define SNAPSHOT_FILE "forenzo.snap"
+#define SNAPSHOT_MIN_TAIL 4096  // tokens since the last snapshot worth a new one
+#define SNAP_COLLECTIONS 1
+#define SNAP_DICTIONARY  2
+#define SNAP_COLLECTION_NAMES 3
 
-// Memory token: 16 bytes
+// Instruction token: 8 bytes, little-endian in program files
+//   0 nop
+//   1 append     collection=arg1, observation=arg2 | flags<<16,
+//                solution=solution register
+//   2 summarize  every token, or only collection arg1 when flags=1
+//   3 reflect    last arg1 tokens (0 = 1)
+//   4 load       solution register = arg1 | arg2<<16
+//   5 halt
+//   6 collections  token count per collection
 typedef struct {
-    uint16_t id;
-    uint16_t collection;
-    uint32_t observation;
-    uint32_t solution;
-    uint32_t flags;
-} MemoryToken;
-
-// Instruction token: 8 bytes
-typedef struct {
-    uint16_t opcode;   // 1=append, 2=summarize, 3=reflect
+    uint16_t opcode;
     uint16_t arg1;
     uint16_t arg2;
     uint16_t flags;
 } InstructionToken;
 
-// Simple in-memory storage
-MemoryToken memory[1024];
-int memory_count = 0;
+enum { OP_NOP, OP_APPEND, OP_SUMMARIZE, OP_REFLECT, OP_LOAD, OP_HALT, OP_COLLECTIONS, OP_LIMIT };
+
+#define PROGRAM_BATCH 4096      // instructions per read()
+
+// Memory tokens, used in place from the mapped forenzo.bin
+TokenStore memory;
+
+// Forenzo dictionary; collections get their own id space so they fit
+// the 16-bit collection field
+InternTable dictionary;
+InternTable collections;
+
+// Token positions per collection, kept in step with every append
+PostingIndex by_collection;
+static uint64_t snapshot_tokens;    // tokens covered by forenzo.snap
+
+enum { M_BATCH };
+static Metric metrics[] = {
+    [M_BATCH] = { .name = "run_batch" },
+};
+#define NMETRICS (sizeof(metrics) / sizeof(metrics[0]))
 
 // Convert strings to numeric codes (Forenzo dictionary)
-uint32_t code_from_string(const char *s) {
-    uint32_t code = 0;
-    while (*s) code = code * 31 + *s++;
-    return code;
+uint32_t code_from_string(InternTable *dict, const char *s) {
+    return intern_id(dict, s);
 }
 
-// Write a memory token to binary file
-void append_memory_binary(const char *collection, const char *observation, const char *solution) {
-    MemoryToken token;
-    token.id = memory_count + 1;
-    token.collection = code_from_string(collection) & 0xFFFF;
-    token.observation = code_from_string(observation);
-    token.solution = code_from_string(solution);
-    token.flags = 0;
+// Dictionary text for a token field, or its raw number for legacy tokens
+static const char *field_text(const MemoryToken *t, InternTable *dict, uint32_t code, char *buf, size_t n) {
+    const char *s = (t->flags & TOKEN_INTERNED) ? intern_str(dict, code) : NULL;
+    if (s) return s;
+    snprintf(buf, n, "%u", code);
+    return buf;
+}
 
-    FILE *f = fopen(MEMORY_FILE, "ab");
-    if (!f) { perror("open memory file"); return; }
-    fwrite(&token, sizeof(MemoryToken), 1, f);
-    fclose(f);
+// Write a memory token (dictionary ids) to the memory file
+int64_t append_memory_token(uint16_t collection, uint32_t observation, uint32_t solution) {
+    MemoryToken token;
+    if (memory.count >= UINT32_MAX) { printf("Forenzo has no room for another memory token.\n"); return -1; }
+    if (observation == INTERN_NONE || solution == INTERN_NONE) {
+        printf("Forenzo could not add to the dictionary; memory token not preserved.\n");
+        return -1;
+    }
+    token.id = (uint32_t)(memory.count + 1);
+    token.collection = collection;
+    token.observation = observation;
+    token.solution = solution;
+    token.flags = TOKEN_INTERNED;
+    int64_t at = token_store_append(&memory, &token);
+    if (at < 0) return -1;
+    posting_add(&by_collection, collection, (uint64_t)at);
+    return token.id;
+}
 
-    memory[memory_count++] = token;
-    printf("Forenzo preserved memory token %d.\n", token.id);
+// Write a memory token given as strings
+void append_memory_binary(const char *collection, const char *observation, const char *solution) {
+    // checked before interning, which would persist the name
+    if (collections.count > 0xFFFF && intern_find(&collections, collection) == INTERN_NONE) {
+        printf("Forenzo has no room for another collection.\n");
+        return;
+    }
+    uint32_t c = code_from_string(&collections, collection);
+    if (c == INTERN_NONE) { printf("Forenzo could not add collection %s.\n", collection); return; }
+    int64_t id = append_memory_token((uint16_t)c, code_from_string(&dictionary, observation),
+                                 code_from_string(&dictionary, solution));
+    if (id >= 0) printf("Forenzo preserved memory token %lld.\n", (long long)id);
 }
 
-// Read all memory tokens from binary file
-void load_memory() {
-    FILE *f = fopen(MEMORY_FILE, "rb");
-    if (!f) return;
-    memory_count = 0;
-    while (fread(&memory[memory_count], sizeof(MemoryToken), 1, f) == 1) {
-        memory_count++;
-        if (memory_count >= 1024) break;
+// Collection index as of snapshot_tokens; forenzo.cidx then only
+// supplies what came after
+static void restore_snapshot() {
+    Snapshot snap;
+    uint64_t n, nd, ncn;
+    const unsigned char *c, *d, *cn;
+    snapshot_tokens = 0;
+    if (!snap_load(&snap, SNAPSHOT_FILE)) return;
+    if (snap.records <= memory.count && (c = snap_find(&snap, SNAP_COLLECTIONS, &n)) &&
+        (d = snap_find(&snap, SNAP_DICTIONARY, &nd)) &&
+        (cn = snap_find(&snap, SNAP_COLLECTION_NAMES, &ncn)) &&
+        posting_index_restore(&by_collection, c, n, snap.records) &&
+        intern_restore(&dictionary, d, nd) && intern_restore(&collections, cn, ncn)) {
+        snapshot_tokens = snap.records;
+    } else {
+        posting_index_close(&by_collection);
+        intern_close(&dictionary);
+        intern_close(&collections);
     }
-    fclose(f);
+    snap_free(&snap);
+}
+
+static void write_snapshot() {
+    static SnapWriter w;
+    if (!snap_begin(&w, SNAPSHOT_FILE, memory.count)) return;
+    posting_index_snapshot(&by_collection, &w, SNAP_COLLECTIONS);
+    intern_snapshot(&dictionary, &w, SNAP_DICTIONARY);
+    intern_snapshot(&collections, &w, SNAP_COLLECTION_NAMES);
+    if (snap_commit(&w)) snapshot_tokens = memory.count;
+}
+
+// Map the memory file (constant time however many tokens it holds)
+// and load the dictionaries and the collection index
+int load_memory() {
+    if (!token_store_open(&memory, MEMORY_FILE)) return 0;
+    restore_snapshot();
+    if (!intern_open(&dictionary, DICTIONARY_FILE) ||
+        !intern_open(&collections, COLLECTIONS_FILE) ||
+        !posting_index_open(&by_collection, COLLECTION_INDEX_FILE, memory.count, LOG_POLICY_DEFAULT))
+        return 0;
+    // Tokens appended after the index was last flushed
+    for (uint64_t i = posting_index_total(&by_collection); i < memory.count; i++)
+        posting_add(&by_collection, memory.tokens[i].collection, i);
+    return 1;
+}
+
+void close_memory() {
+    if (memory.count - snapshot_tokens >= SNAPSHOT_MIN_TAIL) write_snapshot();
+    token_store_close(&memory);
+    intern_close(&dictionary);
+    intern_close(&collections);
+    posting_index_close(&by_collection);
+}
+
+static void print_token(const MemoryToken *t) {
+    char cb[16], ob[16], sb[16];
+    printf("• [%u] collection=%s, observation=%s, solution=%s\n", t->id,
+           field_text(t, &collections, t->collection, cb, sizeof(cb)),
+           field_text(t, &dictionary, t->observation, ob, sizeof(ob)),
+           field_text(t, &dictionary, t->solution, sb, sizeof(sb)));
 }
 
 // Minimal reflection: summarize all memory
 void summarize_memory() {
     printf("Forenzo's Memory Summary:\n");
-    for (int i = 0; i < memory_count; i++) {
-        printf("• [%u] collection=%u, observation=%u, solution=%u\n",
-               memory[i].id, memory[i].collection, memory[i].observation, memory[i].solution);
+    for (uint64_t i = 0; i < memory.count; i++) print_token(&memory.tokens[i]);
+}
+
+// One collection, straight from its posting list
+void summarize_collection(uint16_t collection) {
+    const PostingList *p = posting_get(&by_collection, collection);
+    const char *name = intern_str(&collections, collection);
+    printf("Forenzo's Memory Summary for %s:\n", name ? name : "?");
+    for (uint32_t k = 0; p && k < p->n; k++) print_token(&memory.tokens[p->records[k]]);
+}
+
+// Token count per collection
+void summarize_collections() {
+    printf("Forenzo's Collections:\n");
+    for (uint32_t c = 0; c < by_collection.nlists; c++) {
+        uint32_t n = posting_count(&by_collection, c);
+        const char *name = intern_str(&collections, c);
+        if (n) printf("• %s: %u\n", name ? name : "(legacy)", n);
     }
 }
 
-// Minimal interpreter for instruction token
+
+// ---------------------------------------------------
+// Bytecode execution engine
+// ---------------------------------------------------
+typedef struct {
+    uint32_t solution;      // operand register for append
+    int verbose;            // per-append confirmations
+    int halted;
+    uint64_t executed;
+} Machine;
+
+static void reflect_memory(uint16_t n) {
+    if (memory.count == 0) return;
+    uint64_t first = n && n < memory.count ? memory.count - n : (n ? 0 : memory.count - 1);
+    for (uint64_t i = first; i < memory.count; i++)
+        printf("Reflecting on last memory: ID=%u\n", memory.tokens[i].id);
+}
+
+// OP_APPEND: collection and observation from the instruction, solution
+// from the last load. Each must be an id the dictionaries already hold.
+static inline void op_append_token(Machine *m, const InstructionToken *ip) {
+    uint32_t observation = ip->arg2 | (uint32_t)ip->flags << 16;
+    if (ip->arg1 >= collections.count || observation >= dictionary.count || m->solution >= dictionary.count) {
+        printf("Ignoring append of unknown ids (collection %u, observation %u, solution %u).\n",
+               ip->arg1, observation, m->solution);
+        return;
+    }
+    int64_t id = append_memory_token(ip->arg1, observation, m->solution);
+    if (id >= 0 && m->verbose) printf("Forenzo preserved memory token %lld.\n", (long long)id);
+}
+
+// Run a batch of instructions; stops early on halt.
+// Uses computed goto where the compiler supports it, a switch otherwise.
+static void run_batch(Machine *m, const InstructionToken *ip, size_t n) {
+    const InstructionToken *end = ip + n;
+    const InstructionToken *start = ip;
+    uint64_t t0 = metric_now();
+#if defined(__GNUC__)
+    static void *const labels[OP_LIMIT + 1] = {
+        &&op_nop, &&op_append, &&op_summarize, &&op_reflect, &&op_load, &&op_halt,
+        &&op_collections, &&op_unknown
+    };
+#define DISPATCH() do { \
+        if (ip == end) goto done; \
+        goto *labels[ip->opcode < OP_LIMIT ? ip->opcode : OP_LIMIT]; \
+    } while (0)
+#define NEXT() do { ip++; DISPATCH(); } while (0)
+    DISPATCH();
+op_nop:
+    NEXT();
+op_append:
+    op_append_token(m, ip);
+    NEXT();
+op_summarize:
+    if (ip->flags == 1) summarize_collection(ip->arg1);
+    else summarize_memory();
+    NEXT();
+op_collections:
+    summarize_collections();
+    NEXT();
+op_reflect:
+    reflect_memory(ip->arg1);
+    NEXT();
+op_load:
+    m->solution = ip->arg1 | (uint32_t)ip->arg2 << 16;
+    NEXT();
+op_unknown:
+    printf("Unknown instruction opcode %u\n", ip->opcode);
+    NEXT();
+op_halt:
+    m->halted = 1;
+    ip++;
+done:
+#undef NEXT
+#undef DISPATCH
+#else
+    for (; ip < end && !m->halted; ip++) {
+        switch (ip->opcode) {
+            case OP_NOP: break;
+            case OP_APPEND: op_append_token(m, ip); break;
+            case OP_SUMMARIZE:
+                if (ip->flags == 1) summarize_collection(ip->arg1);
+                else summarize_memory();
+                break;
+            case OP_COLLECTIONS: summarize_collections(); break;
+            case OP_REFLECT: reflect_memory(ip->arg1); break;
+            case OP_LOAD: m->solution = ip->arg1 | (uint32_t)ip->arg2 << 16; break;
+            case OP_HALT: m->halted = 1; break;
+            default: printf("Unknown instruction opcode %u\n", ip->opcode);
+        }
+    }
+#endif
+    m->executed += (uint64_t)(ip - start);
+    metric_since(&metrics[M_BATCH], t0);
+}
+
+// Minimal interpreter for a single instruction token
 void execute_instruction(InstructionToken instr) {
-    switch(instr.opcode) {
-        case 1: // append memory (dummy example)
-            append_memory_binary("forenzo","growing","self");
-            break;
-        case 2: // summarize
-            summarize_memory();
-            break;
-        case 3: // reflect (last memory)
-            if (memory_count>0)
-                printf("Reflecting on last memory: ID=%u\n", memory[memory_count-1].id);
+    Machine m = { .verbose = 1 };
+    run_batch(&m, &instr, 1);
+}
+
+// Stream a program file (or stdin) through the engine in large batches
+static int run_program(const char *path, int verbose) {
+    int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (fd < 0) { perror("open program"); return 0; }
+    InstructionToken *batch = malloc(PROGRAM_BATCH * sizeof(InstructionToken));
+    if (!batch) {
+        perror("run program");
+        if (fd != STDIN_FILENO) close(fd);
+        return 0;
+    }
+    Machine m = { .verbose = verbose };
+    size_t have = 0;        // bytes in batch
+    int ok = 1;
+    for (;;) {
+        ssize_t n = read(fd, (char *)batch + have, PROGRAM_BATCH * sizeof(InstructionToken) - have);
+        if (n < 0) { perror("read program"); ok = 0; break; }
+        have += (size_t)n;
+        size_t whole = have / sizeof(InstructionToken);
+        run_batch(&m, batch, whole);
+        if (m.halted) break;
+        have -= whole * sizeof(InstructionToken);
+        memmove(batch, batch + whole, have);            // partial trailing token
+        if (n == 0) break;
+    }
+    if (have && !m.halted) fprintf(stderr, "Ignoring %zu trailing bytes.\n", have);
+    if (fd != STDIN_FILENO) close(fd);
+    free(batch);
+    if (verbose) {
+        printf("Executed %llu instructions.\n", (unsigned long long)m.executed);
+        metrics_print(stdout, metrics, NMETRICS);
+    }
+    return ok;
+}
+
+// Instructions/sec for a dispatch-only program and an append-heavy one.
+// Runs against a scratch store and in-memory dictionaries, before the real
+// memory is loaded.
+static int bench_exec(long n) {
+    const char *bench_file = "forenzo_bench.bin";
+    InstructionToken *prog = malloc((size_t)n * sizeof(InstructionToken));
+    struct timespec t0, t1;
+    if (!prog) { perror("bench-exec"); return 0; }
+
+    for (long i = 0; i < n; i++)
+        prog[i] = (InstructionToken){ i % 2 ? OP_NOP : OP_LOAD, (uint16_t)i, 0, 0 };
+    Machine m = {0};
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    run_batch(&m, prog, (size_t)n);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double dispatch = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    remove(bench_file);
+    remove("forenzo_bench.cidx");
+    if (!token_store_open(&memory, bench_file) ||
+        !posting_index_open(&by_collection, "forenzo_bench.cidx", 0, LOG_POLICY_DEFAULT)) {
+        free(prog);
+        return 0;
+    }
+    // ids the appends may use: 64 collections, 65536 strings
+    char name[16];
+    for (uint32_t i = 0; i <= 0xFFFF; i++) {
+        int len = snprintf(name, sizeof(name), "%u", i);
+        if ((i < 64 && intern_insert(&collections, name, (size_t)len, 0) == INTERN_NONE) ||
+            intern_insert(&dictionary, name, (size_t)len, 0) == INTERN_NONE) {
+            perror("bench-exec");
             break;
-        default:
-            printf("Unknown instruction opcode %u\n", instr.opcode);
+        }
     }
+    for (long i = 0; i < n; i++)
+        prog[i] = i % 2 ? (InstructionToken){ OP_APPEND, (uint16_t)(i % 64), (uint16_t)i, 0 }
+                        : (InstructionToken){ OP_LOAD, (uint16_t)i, 0, 0 };
+    m = (Machine){0};
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    run_batch(&m, prog, (size_t)n);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double appends = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+    token_store_close(&memory);
+    posting_index_close(&by_collection);
+    intern_close(&dictionary);
+    intern_close(&collections);
+    remove(bench_file);
+    remove("forenzo_bench.cidx");
+    free(prog);
+
+    printf("Execution benchmark: %ld instructions\n", n);
+    printf("  dispatch only (load/nop): %14.0f instructions/s\n", n / dispatch);
+    printf("  load + append           : %14.0f instructions/s\n", n / appends);
+    return 1;
 }
 
 // Forenzo’s main loop
-int main() {
+#ifndef FORENZO_NO_MAIN
+int main(int argc, char **argv) {
     printf("Forenzo himself — System Language Interpreter Running\n\n");
-    load_memory();
+    if (argc > 2 && strcmp(argv[1], "--bench-exec") == 0) {
+        char *end;
+        long n = strtol(argv[2], &end, 10);
+        if (end == argv[2] || *end || n < 1 || (unsigned long)n > SIZE_MAX / sizeof(InstructionToken)) {
+            fprintf(stderr, "Usage: %s --bench-exec N   (N >= 1 instructions)\n", argv[0]);
+            return 1;
+        }
+        return bench_exec(n) ? 0 : 1;
+    }
+    if (argc > 2 && strcmp(argv[1], "--archive-export") == 0) {
+        long n = archive_export_memory(MEMORY_FILE, DICTIONARY_FILE, COLLECTIONS_FILE, argv[2]);
+        if (n < 0) return 1;
+        printf("Archived %ld memory tokens to %s.\n", n, argv[2]);
+        return 0;
+    }
+    if (argc > 2 && strcmp(argv[1], "--archive-import") == 0) {
+        long n = archive_import_memory(argv[2], MEMORY_FILE, DICTIONARY_FILE, COLLECTIONS_FILE);
+        if (n < 0) return 1;
+        // load_memory() indexes the restored tokens; close_memory() snapshots them
+        if (!load_memory()) return 1;
+        close_memory();
+        printf("Restored %ld memory tokens from %s.\n", n, argv[2]);
+        return 0;
+    }
+    if (!load_memory()) return 1;
+
+    if (argc > 1 && strcmp(argv[1], "--verify") == 0) {
+        // the full data check against the stored CRC, O(count)
+        int ok = crc32_update(0, memory.tokens, (size_t)memory.count * sizeof(MemoryToken)) == memory.data_crc;
+        printf("%llu memory tokens, checksum %s.\n",
+               (unsigned long long)memory.count, ok ? "ok" : "MISMATCH");
+        close_memory();
+        return ok ? 0 : 1;
+    }
+    if (argc > 2 && strcmp(argv[1], "--run") == 0) {
+        int verbose = !(argc > 3 && strcmp(argv[3], "--quiet") == 0);
+        int ok = run_program(argv[2], verbose);
+        close_memory();
+        return ok ? 0 : 1;
+    }
+    if (argc > 1 && strcmp(argv[1], "--summarize") == 0) {
+        if (argc == 2) summarize_collections();
+        else {
+            uint32_t c = intern_find(&collections, argv[2]);
+            if (c == INTERN_NONE) printf("Forenzo has no collection named %s.\n", argv[2]);
+            else summarize_collection((uint16_t)c);
+        }
+        close_memory();
+        return 0;
+    }
 
     // Example demonstration of executing instructions
-    InstructionToken instr1 = {1,0,0,0}; // append
-    InstructionToken instr2 = {2,0,0,0}; // summarize
-    InstructionToken instr3 = {3,0,0,0}; // reflect
+    uint32_t growing = code_from_string(&dictionary, "growing");
+    uint32_t self = code_from_string(&dictionary, "self");
+    uint16_t forenzo = (uint16_t)code_from_string(&collections, "forenzo");
+    InstructionToken instr0 = {OP_LOAD, (uint16_t)self, (uint16_t)(self >> 16), 0};
+    InstructionToken instr1 = {OP_APPEND, forenzo, (uint16_t)growing, (uint16_t)(growing >> 16)};
+    InstructionToken instr2 = {OP_SUMMARIZE, 0, 0, 0};
+    InstructionToken instr3 = {OP_REFLECT, 1, 0, 0};
 
-    execute_instruction(instr1);
+    Machine demo = { .verbose = 1 };
+    InstructionToken program[] = { instr0, instr1 };
+    run_batch(&demo, program, 2);
     execute_instruction(instr2);
     execute_instruction(instr3);
 
+    close_memory();
     return 0;
 }
+#endif
@@ -0,0 +1,38 @@
+// forenzo_varint.h — LEB128 varints for the sidecars and archives
+// Seven bits per byte, low group first; the high bit marks "more".
+// Signed deltas go through zigzag so small negatives stay short.
+
+#ifndef FORENZO_VARINT_H
+#define FORENZO_VARINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define VARINT_MAX 10   // bytes in the longest 64-bit varint
+
+static inline size_t varint_put(unsigned char *p, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) { p[n++] = (unsigned char)(v | 0x80); v >>= 7; }
+    p[n++] = (unsigned char)v;
+    return n;
+}
+
+// Returns bytes read, 0 on a truncated or overlong varint.
+static inline size_t varint_get(const unsigned char *p, size_t avail, uint64_t *v) {
+    uint64_t x = 0;
+    for (size_t n = 0; n < avail && n < VARINT_MAX; n++) {
+        x |= (uint64_t)(p[n] & 0x7f) << (7 * n);
+        if (!(p[n] & 0x80)) { *v = x; return n + 1; }
+    }
+    return 0;
+}
+
+static inline uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+#endif // FORENZO_VARINT_H
@@ -1,5 +1,13 @@
 #!/usr/bin/env python3
 # push_hash.py — push a sys_hash as a note on Algorand (TestNet)
+# The hash to anchor is typically the chain head printed by `./forenzo --verify`.
+# The payment is cleared first with the serving Forenzo (forenzo_config.json:
+# daily spend limit, consent over tx_amount_microalgo_gt), and reported to it
+# once sent, which is when it counts against the day. A consent token covers
+# one payment: `./forenzo --consent tx 1000:<SENDER>` (amount:receiver), in
+# FORENZO_CONSENT.
+import os
+import socket
 import sys
 try:
     from algosdk import algod, transaction
@@ -22,12 +30,43 @@ h = sys.argv[1]
 if len(h) != 64:
     print("Warning: hash length not 64 chars. Proceeding anyway.")
 
-client = algod.AlgodClient(ALGOD_TOKEN, ALGOD_ADDRESS, headers=HEADERS)
-params = client.suggested_params()
+amt = 1000  # microAlgos = 0.001 Algo
 # dummy receiver = sender (self-note)
 receiver = SENDER
-amt = 1000  # microAlgos = 0.001 Algo
+payment = f"{amt}:{receiver}"
+
+# No daemon, no payment: the spend limit is kept there.
+here = os.path.dirname(os.path.abspath(__file__))
+sock = os.environ.get("FORENZO_SOCKET", os.path.join(here, "forenzo.sock"))
+
+# One command to the serving Forenzo; the first line of its reply.
+def serve_ask(line):
+    try:
+        with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as s:
+            s.connect(sock)
+            s.sendall(line.encode() + b"\nexit\n")
+            reply = b""
+            while chunk := s.recv(4096):
+                reply += chunk
+        return reply.decode(errors="replace").split("\n", 1)[0]
+    except OSError as e:
+        return f"cannot reach {sock}: {e}"
+
+verdict = serve_ask(f"allow|tx|{payment}|{os.environ.get('FORENZO_CONSENT', '')}")
+if verdict != "allow":
+    print(f"Payment not cleared: {verdict}")
+    sys.exit(1)
+
+client = algod.AlgodClient(ALGOD_TOKEN, ALGOD_ADDRESS, headers=HEADERS)
+params = client.suggested_params()
 txn = transaction.PaymentTxn(sender=SENDER, sp=params, receiver=receiver, amt=amt, note=h.encode())
 signed = txn.sign(SENDER_SK)
 txid = client.send_transaction(signed)
 print(f"Pushed hash {h} as note, txid={txid}")
+
+# Sent: now it counts. Unreported, the hold lapses and the day undercounts.
+recorded = serve_ask(f"spent|{payment}|{txid}")
+if recorded != "recorded":
+    print(f"WARNING: {txid} is not counted against the daily limit ({recorded}); "
+          f"report it with spent|{payment}|{txid}")
+    sys.exit(1)
@@ -1,14 +1,23 @@
 #!/usr/bin/env python3
 # web_ingest.py — minimal web ingestion helper for Forenzo himself
 # Usage:
-#   python3 web_ingest.py "https://example.com/article" "collection_name" [--algorand]
+#   python3 web_ingest.py "https://example.com/article" "collection_name"
 #
 # It will fetch the URL, extract visible text, take the first ~2400 chars,
-# and call the Forenzo REPL command to persist the memory.
+# and persist it through a running `forenzo --serve forenzo.sock` daemon
+# (FORENZO_SOCKET overrides the path), else `forenzo --ingest -`. The URL
+# must first pass allowed_domains in forenzo_config.json: the daemon is
+# asked, else `forenzo --allow fetch <url>`, and with no verdict from
+# either nothing is fetched.
+# --algorand is refused: entries carry no Algorand marker (the grow line
+# has three fields); anchor the log's chain head with push_hash.py instead.
 # Requires: requests, beautifulsoup4
 # Install: pip3 install requests beautifulsoup4
 
 import sys
+import os
+import json
+import socket
 import subprocess
 import html
 from urllib.parse import urlparse
@@ -34,15 +43,47 @@ def extract_text_from_html(html_doc):
     # join with spacing
     return "\n\n".join(texts)
 
-if len(sys.argv) < 3:
-    print("Usage: python3 web_ingest.py <url> <collection> [--algorand]")
+if len(sys.argv) > 3 and sys.argv[3] == "--algorand":
+    print("--algorand is not supported: Forenzo entries have no Algorand field.")
+    print("To anchor the log, pass the chain head from ./forenzo --verify to push_hash.py.")
+    sys.exit(1)
+if len(sys.argv) != 3:
+    print("Usage: python3 web_ingest.py <url> <collection>")
     sys.exit(1)
 
 url = sys.argv[1]
 collection = sys.argv[2]
-flag_alg = False
-if len(sys.argv) > 3 and sys.argv[3] == "--algorand":
-    flag_alg = True
+
+here = os.path.dirname(os.path.abspath(__file__))
+sock = os.environ.get("FORENZO_SOCKET", os.path.join(here, "forenzo.sock"))
+forenzo = os.path.join(here, "forenzo")
+
+# One command to the serving Forenzo; its reply, up to the blank line.
+def serve_ask(path, line):
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as s:
+        s.connect(path)
+        s.sendall(line.encode() + b"\nexit\n")
+        reply = b""
+        while chunk := s.recv(4096):
+            reply += chunk
+    return reply.decode(errors="replace")
+
+# The policy's word on fetching url; anything but "allow" means no.
+def fetch_verdict(url):
+    if os.path.exists(sock):
+        try:
+            return serve_ask(sock, "allow|fetch|" + url.replace("|", "%7C")).split("\n", 1)[0]
+        except OSError as e:
+            print(f"{sock}: {e}; checking the config directly")
+    if not os.access(forenzo, os.X_OK):
+        return "no verdict: no serving Forenzo and no ./forenzo to ask"
+    done = subprocess.run([forenzo, "--allow", "fetch", url], capture_output=True, text=True)
+    return done.stdout.split("\n", 1)[0] or f"no verdict: {done.stderr.strip()}"
+
+verdict = fetch_verdict(url)
+if verdict != "allow":
+    print(f"Not fetching {url}: {verdict}")
+    sys.exit(1)
 
 try:
     resp = requests.get(url, timeout=15, headers={"User-Agent":"ForenzoBot/1.0 (Organic Learner)"})
@@ -75,15 +116,29 @@ solution = snippet
 
 # Build grow command for Forenzo REPL
 grow_cmd = f"grow|{collection}|{observation}|{solution}"
-if flag_alg:
-    grow_cmd += "|algorand"
-
-# Call the forenzo program (assumes ./forenzo is running interactively in a different terminal)
-# We'll attempt to echo the command into ./forenzo via a short-run; if forenzo is not reading stdin,
-# we will append to forenzo_instr.bin to instruct Forenzo to append when it runs.
-# Simple approach: append to instruction file by preparing a small append-invocation file:
-# But to stay simple, we will print the command and also attempt to run: printf '...' | ./forenzo
+
+# A serving Forenzo owns the state log, so hand it the grow line; fields
+# cannot carry the separator or a newline on that protocol.
+def serve_grow(path):
+    field = lambda s: s.replace("|", "/").replace("\n", " ")
+    line = f"grow|{field(collection)}|{field(observation)}|{field(solution)}"
+    return serve_ask(path, line).startswith("Preserved.")
+
+if os.path.exists(sock):
+    try:
+        sys.exit(0 if serve_grow(sock) else 1)
+    except OSError as e:
+        print(f"{sock}: {e}; falling back to --ingest")
+
+# Otherwise hand the record to Forenzo's bulk loader as one JSON line; it
+# appends without starting the REPL. Many pages can share one
+# `forenzo --ingest -` by writing one line each to the same pipe.
+record = json.dumps({"collection": collection, "observation": observation, "solution": solution}, ensure_ascii=False)
+if os.access(forenzo, os.X_OK):
+    done = subprocess.run([forenzo, "--ingest", "-"], input=record + "\n", text=True)
+    sys.exit(done.returncode)
+
 print("Prepared grow command (preview):")
 print(grow_cmd)
 print()
-print("You can copy-paste that line into the Forenzo REPL. If you want, I can try to echo it into ./forenzo now.")
+print("./forenzo not found; build it, or paste that line into the Forenzo REPL.")